@@ -0,0 +1,409 @@
+/**
+ * olog_bench: 测量 OLOG 的调用延迟以及日志写入文件的吞吐量。
+ *
+ * 用法：olog_bench [-t threads] [-n records] [-i iterations]
+ *                  [-f text|binary] [-p block|drop] [-s stall ns]
+ *                  [-w append|positioned|direct]
+ *                  [-d none|periodic|error|every] [-z none|noop|zstd]
+ *                  [-o log file]
+ * -t 吞吐量测试的最大生产者线程数，依次测试 1、2、4……直到该值，默认为 4。
+ * -n 吞吐量测试中每个生产者写入的日志数，默认为 1000000。
+ * -i 延迟测试中每种格式串的调用次数，默认为 100000。
+ * -f 日志的输出格式，默认为 text。
+ * -p 生产者缓冲区已满时的处理方式，默认为 block。
+ * -s 单次调用超过该纳秒数时记为一次停顿，默认为 10000。
+ * -w 写入日志文件的方式，默认为 append。
+ * -d 日志写入文件后的持久化方式，默认为 every。
+ * -z 压缩输出缓冲区的压缩器，默认为 none，即不压缩。
+ *    zstd 只在构建时找到 zstd 才可用。
+ * -o 日志文件，每项测试前会被删除，默认为 olog_bench.log。
+ *
+ * 每项测试都在单独的子进程中进行。子进程退出时 Logger 会写完全部日志，
+ * 所以吞吐量包含了日志线程把日志写入文件的时间；
+ * 日志线程的 CPU 时间为子进程的 CPU 时间减去各生产者线程的 CPU 时间，
+ * 压缩时也包含压缩线程的 CPU 时间。
+ */
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <ios>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "olog.h"
+
+namespace {
+
+// 延迟测试中连续调用的次数。每批调用之后暂停一段时间，
+// 让日志线程清空缓冲区，避免测得的是缓冲区已满时的等待时间。
+const size_t LATENCY_BURST_SIZE = 1000;
+
+// 延迟测试中每批调用之后暂停的时间。
+const std::chrono::milliseconds LATENCY_BURST_INTERVAL(2);
+
+enum class CompressorType { NONE, NOOP, ZSTD };
+
+struct BenchOptions {
+    int max_threads_ = 4;
+    size_t records_per_thread_ = 1000000;
+    size_t latency_iterations_ = 100000;
+    OutputFormat output_format_ = OutputFormat::TEXT;
+    OverflowPolicy overflow_policy_ = OverflowPolicy::BLOCK;
+    int64_t stall_ns_ = 10000;
+    WriteMode write_mode_ = WriteMode::APPEND;
+    DurabilityPolicy durability_policy_ = DurabilityPolicy::EVERY_WRITE;
+    CompressorType compressor_type_ = CompressorType::NONE;
+    const char* log_file_ = "olog_bench.log";
+};
+
+// 吞吐量测试中每个生产者线程通过管道交给父进程的结果。
+struct ProducerResult {
+    int64_t cpu_ns_;
+    uint64_t stalls_;
+};
+
+int64_t ThreadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int64_t ToNs(const timeval& tv) {
+    return static_cast<int64_t>(tv.tv_sec) * 1000000000 + tv.tv_usec * 1000;
+}
+
+/**
+ * @brief
+ * 在子进程中配置 Logger。Logger 单例在第一次使用时才会被创建，
+ * 所以父进程中不能使用 OLog。
+ */
+void SetUpLogger(const BenchOptions& options) {
+    Logger::SetOutputFormat(options.output_format_);
+    Logger::SetOverflowPolicy(options.overflow_policy_);
+    Logger::SetWriteMode(options.write_mode_);
+    Logger::SetDurabilityPolicy(options.durability_policy_);
+    Logger::SetLogFile(options.log_file_);
+    switch (options.compressor_type_) {
+    case CompressorType::NONE:
+        break;
+    case CompressorType::NOOP:
+        Logger::SetCompressor(
+            std::make_unique<olog::compression::NoopCompressor>());
+        break;
+    case CompressorType::ZSTD:
+#ifdef OLOG_WITH_ZSTD
+        Logger::SetCompressor(
+            std::make_unique<olog::compression::ZstdCompressor>());
+#endif
+        break;
+    }
+}
+
+/**
+ * @brief
+ * 在子进程中执行 child_main，等待子进程结束。
+ *
+ * @param child_main 子进程的主函数，返回子进程的退出码。
+ * @param usage 子进程全部线程的资源使用情况。
+ * @param wall_ns 从创建子进程到子进程结束的时间。
+ * @return 子进程正常结束时返回 true。
+ */
+template <typename _Fn>
+bool RunInChild(_Fn child_main, rusage& usage, int64_t& wall_ns) {
+    fflush(stdout);
+    int64_t start_ns = olog::utils::GetNsSystemClockInterval();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Can't fork: %s\n", strerror(errno));
+        return false;
+    }
+    if (pid == 0) {
+        int exit_code = EXIT_FAILURE;
+        try {
+            exit_code = child_main();
+        } catch (const std::ios_base::failure& e) {
+            fprintf(stderr, "%s\n", e.what());
+        }
+        // 正常退出，由 Logger 的析构函数写完全部日志。
+        exit(exit_code);
+    }
+
+    int status = 0;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        fprintf(stderr, "Can't wait for child: %s\n", strerror(errno));
+        return false;
+    }
+    wall_ns = olog::utils::GetNsSystemClockInterval() - start_ns;
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/**
+ * @brief
+ * 测量一种格式串的调用延迟并输出各个分位数。
+ *
+ * @param log_once 以调用序号为参数，调用一次 OLOG。
+ */
+template <typename _Fn>
+void MeasureLatency(const BenchOptions& options, const char* name,
+                    _Fn log_once) {
+    auto child_main = [&options, name, &log_once]() {
+        SetUpLogger(options);
+        olog::utils::TscClock tsc_clock;
+        double ns_per_tick = tsc_clock.getCalibration().ns_per_tick_;
+
+        std::vector<uint64_t> ticks(options.latency_iterations_);
+        for (size_t i = 0; i < ticks.size(); ++i) {
+            if (i > 0 && i % LATENCY_BURST_SIZE == 0)
+                std::this_thread::sleep_for(LATENCY_BURST_INTERVAL);
+            uint64_t start = olog::utils::ReadTsc();
+            log_once(static_cast<int>(i));
+            ticks[i] = olog::utils::ReadTsc() - start;
+        }
+
+        uint64_t stalls = std::count_if(
+            ticks.begin(), ticks.end(), [&](uint64_t t) {
+                return t * ns_per_tick > static_cast<double>(options.stall_ns_);
+            });
+        std::sort(ticks.begin(), ticks.end());
+        auto percentile = [&](double p) {
+            size_t idx = static_cast<size_t>(p * (ticks.size() - 1));
+            return static_cast<double>(ticks[idx]) * ns_per_tick;
+        };
+        printf("%-16s %9.1f %9.1f %9.1f %11.1f %8lu\n", name, percentile(0.5),
+               percentile(0.99), percentile(0.999), percentile(1.0), stalls);
+        return EXIT_SUCCESS;
+    };
+
+    unlink(options.log_file_);
+    rusage usage;
+    int64_t wall_ns = 0;
+    if (!RunInChild(child_main, usage, wall_ns))
+        fprintf(stderr, "%s: benchmark failed\n", name);
+}
+
+/**
+ * @brief 统计文本日志的行数。
+ */
+size_t CountLines(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (file == nullptr)
+        return 0;
+    size_t num_lines = 0;
+    char buffer[64 * 1024];
+    size_t nbytes = 0;
+    while ((nbytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        num_lines += std::count(buffer, buffer + nbytes, '\n');
+    fclose(file);
+    return num_lines;
+}
+
+/**
+ * @brief
+ * 使用 num_threads 个生产者测量日志写入文件的吞吐量。
+ */
+void MeasureThroughput(const BenchOptions& options, int num_threads) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) < 0) {
+        fprintf(stderr, "Can't create pipe: %s\n", strerror(errno));
+        return;
+    }
+
+    auto child_main = [&options, num_threads, &pipe_fds]() {
+        close(pipe_fds[0]);
+        SetUpLogger(options);
+        olog::utils::TscClock tsc_clock;
+        uint64_t stall_ticks = static_cast<uint64_t>(
+            options.stall_ns_ / tsc_clock.getCalibration().ns_per_tick_);
+        const char* payload = "0123456789abcdefghijklmnopqrstuv";
+
+        std::vector<ProducerResult> results(num_threads);
+        std::vector<std::thread> producers;
+        for (int id = 0; id < num_threads; ++id) {
+            producers.emplace_back([&, id]() {
+                int64_t cpu_start = ThreadCpuNs();
+                uint64_t stalls = 0;
+                for (size_t i = 0; i < options.records_per_thread_; ++i) {
+                    uint64_t start = olog::utils::ReadTsc();
+                    OLOG(LogLevel::INFO,
+                         "Throughput record %lu from producer %d: %s %lf", i,
+                         id, payload, i * 0.5);
+                    if (olog::utils::ReadTsc() - start > stall_ticks)
+                        ++stalls;
+                }
+                results[id].cpu_ns_ = ThreadCpuNs() - cpu_start;
+                results[id].stalls_ = stalls;
+            });
+        }
+        for (std::thread& producer : producers)
+            producer.join();
+
+        ProducerResult total = {0, 0};
+        for (const ProducerResult& result : results) {
+            total.cpu_ns_ += result.cpu_ns_;
+            total.stalls_ += result.stalls_;
+        }
+        if (write(pipe_fds[1], &total, sizeof(total)) != sizeof(total))
+            return EXIT_FAILURE;
+        close(pipe_fds[1]);
+        return EXIT_SUCCESS;
+    };
+
+    unlink(options.log_file_);
+    rusage usage;
+    int64_t wall_ns = 0;
+    bool succeeded = RunInChild(child_main, usage, wall_ns);
+    close(pipe_fds[1]);
+
+    ProducerResult total;
+    if (!succeeded ||
+        read(pipe_fds[0], &total, sizeof(total)) != sizeof(total)) {
+        close(pipe_fds[0]);
+        fprintf(stderr, "%d threads: benchmark failed\n", num_threads);
+        return;
+    }
+    close(pipe_fds[0]);
+
+    struct stat file_stat;
+    double file_size = stat(options.log_file_, &file_stat) == 0
+                           ? static_cast<double>(file_stat.st_size)
+                           : 0.0;
+    size_t num_records = options.records_per_thread_ * num_threads;
+    double seconds = wall_ns / 1e9;
+    int64_t consumer_cpu_ns =
+        ToNs(usage.ru_utime) + ToNs(usage.ru_stime) - total.cpu_ns_;
+
+    // 只有未压缩的文本日志可以直接数出写出的日志条数。
+    std::string drops = "-";
+    if (options.output_format_ == OutputFormat::TEXT &&
+        options.compressor_type_ == CompressorType::NONE) {
+        size_t num_lines = CountLines(options.log_file_);
+        drops = std::to_string(num_lines < num_records
+                                   ? num_records - num_lines
+                                   : 0);
+    }
+
+    printf("%-8d %13.0f %9.1f %13.3f %9lu %9s\n", num_threads,
+           num_records / seconds, file_size / seconds / (1024 * 1024),
+           consumer_cpu_ns / 1e9, total.stalls_, drops.c_str());
+}
+
+void PrintUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-t threads] [-n records] [-i iterations] "
+            "[-f text|binary] [-p block|drop] [-s stall ns] "
+            "[-w append|positioned|direct] [-d none|periodic|error|every] "
+            "[-z none|noop|zstd] [-o log file]\n",
+            program);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:n:i:f:p:s:w:d:z:o:")) != -1) {
+        if (opt == 't' && atoi(optarg) > 0) {
+            options.max_threads_ = atoi(optarg);
+        } else if (opt == 'n' && atol(optarg) > 0) {
+            options.records_per_thread_ = atol(optarg);
+        } else if (opt == 'i' && atol(optarg) > 0) {
+            options.latency_iterations_ = atol(optarg);
+        } else if (opt == 'f' && strcmp(optarg, "text") == 0) {
+            options.output_format_ = OutputFormat::TEXT;
+        } else if (opt == 'f' && strcmp(optarg, "binary") == 0) {
+            options.output_format_ = OutputFormat::BINARY;
+        } else if (opt == 'p' && strcmp(optarg, "block") == 0) {
+            options.overflow_policy_ = OverflowPolicy::BLOCK;
+        } else if (opt == 'p' && strcmp(optarg, "drop") == 0) {
+            options.overflow_policy_ = OverflowPolicy::DROP;
+        } else if (opt == 's' && atol(optarg) > 0) {
+            options.stall_ns_ = atol(optarg);
+        } else if (opt == 'w' && strcmp(optarg, "append") == 0) {
+            options.write_mode_ = WriteMode::APPEND;
+        } else if (opt == 'w' && strcmp(optarg, "positioned") == 0) {
+            options.write_mode_ = WriteMode::POSITIONED;
+        } else if (opt == 'w' && strcmp(optarg, "direct") == 0) {
+            options.write_mode_ = WriteMode::DIRECT;
+        } else if (opt == 'd' && strcmp(optarg, "none") == 0) {
+            options.durability_policy_ = DurabilityPolicy::NONE;
+        } else if (opt == 'd' && strcmp(optarg, "periodic") == 0) {
+            options.durability_policy_ = DurabilityPolicy::PERIODIC;
+        } else if (opt == 'd' && strcmp(optarg, "error") == 0) {
+            options.durability_policy_ = DurabilityPolicy::ON_ERROR;
+        } else if (opt == 'd' && strcmp(optarg, "every") == 0) {
+            options.durability_policy_ = DurabilityPolicy::EVERY_WRITE;
+        } else if (opt == 'z' && strcmp(optarg, "none") == 0) {
+            options.compressor_type_ = CompressorType::NONE;
+        } else if (opt == 'z' && strcmp(optarg, "noop") == 0) {
+            options.compressor_type_ = CompressorType::NOOP;
+#ifdef OLOG_WITH_ZSTD
+        } else if (opt == 'z' && strcmp(optarg, "zstd") == 0) {
+            options.compressor_type_ = CompressorType::ZSTD;
+#endif
+        } else if (opt == 'o') {
+            options.log_file_ = optarg;
+        } else {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string short_str(8, 's');
+    const std::string medium_str(64, 'm');
+    const std::string long_str(512, 'l');
+
+    printf("%-16s %9s %9s %9s %11s %8s\n", "latency (ns)", "p50", "p99",
+           "p99.9", "max", "stalls");
+    MeasureLatency(options, "no args", [](int) {
+        OLOG(LogLevel::INFO, "Starting backup replica garbage collector");
+    });
+    MeasureLatency(options, "ints", [](int i) {
+        OLOG(LogLevel::INFO, "Backup storage speeds: %d MB/s read, %d MB/s",
+             i, i * 2);
+    });
+    MeasureLatency(options, "doubles", [](int i) {
+        OLOG(LogLevel::INFO, "Using tombstone ratio %lf with %.3lf load",
+             i * 0.1, i * 0.01);
+    });
+    MeasureLatency(options, "%s (8)", [&short_str](int) {
+        OLOG(LogLevel::INFO, "Opened session with %s", short_str.c_str());
+    });
+    MeasureLatency(options, "%s (64)", [&medium_str](int) {
+        OLOG(LogLevel::INFO, "Opened session with %s", medium_str.c_str());
+    });
+    MeasureLatency(options, "%s (512)", [&long_str](int) {
+        OLOG(LogLevel::INFO, "Opened session with %s", long_str.c_str());
+    });
+    MeasureLatency(options, "%.*s (16/512)", [&long_str](int) {
+        OLOG(LogLevel::INFO, "Opened session with %.*s", 16, long_str.c_str());
+    });
+
+    printf("\n%-8s %13s %9s %13s %9s %9s\n", "threads", "records/s", "MB/s",
+           "consumer cpu", "stalls", "drops");
+    for (int num_threads = 1;;
+         num_threads = std::min(num_threads * 2, options.max_threads_)) {
+        MeasureThroughput(options, num_threads);
+        if (num_threads == options.max_threads_)
+            break;
+    }
+
+    unlink(options.log_file_);
+    return EXIT_SUCCESS;
+}
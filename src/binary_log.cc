@@ -0,0 +1,340 @@
+#include "binary_log.h"
+
+#include <stdexcept>
+
+namespace olog {
+namespace binary_log {
+
+namespace {
+
+/**
+ * @brief 将一个对象的字节追加到字符串尾部。
+ */
+template <typename _Tp>
+inline void AppendBytes(std::string& dst, const _Tp& val) {
+    dst.append(reinterpret_cast<const char*>(&val), sizeof(_Tp));
+}
+
+}  // namespace
+
+size_t GetConversionStorageSize(const log_info::StaticLogInfo& static_info) {
+    if (static_info.num_conversions_ == 0)
+        return 0;
+    const log_info::FormatFragment& last =
+        static_info.format_fragments_[static_info.num_conversions_ - 1];
+    return last.storage_pos_ + last.specifier_length_ + 1;
+}
+
+void SerializeStaticInfo(size_t log_id,
+                         const log_info::StaticLogInfo& static_info,
+                         std::string& dst) {
+    StaticInfoHeader header{};
+    header.log_id_ = log_id;
+    header.filename_len_ = strlen(static_info.filename_);
+    header.format_len_ = static_info.format_len_;
+    header.num_conversions_ = static_info.num_conversions_;
+    header.num_parameters_ = static_info.num_parameters_;
+    header.conversion_storage_size_ = GetConversionStorageSize(static_info);
+    header.line_number_ = static_info.line_number_;
+    header.log_level_ = static_cast<uint32_t>(static_info.log_level_);
+
+    EntryHeader entry_header{};
+    entry_header.entry_type_ = EntryType::STATIC_INFO;
+    entry_header.payload_size_ =
+        sizeof(StaticInfoHeader) + header.filename_len_ + header.format_len_ +
+        header.conversion_storage_size_ +
+        header.num_conversions_ * sizeof(FormatFragmentRecord) +
+        header.num_parameters_ * (sizeof(int32_t) + sizeof(uint64_t));
+
+    dst.clear();
+    dst.reserve(sizeof(EntryHeader) + entry_header.payload_size_);
+    AppendBytes(dst, entry_header);
+    AppendBytes(dst, header);
+    dst.append(static_info.filename_, header.filename_len_);
+    dst.append(static_info.format_str_, header.format_len_);
+    dst.append(static_info.conversion_storage_,
+               header.conversion_storage_size_);
+
+    for (size_t i = 0; i < static_info.num_conversions_; ++i) {
+        const log_info::FormatFragment& fragment =
+            static_info.format_fragments_[i];
+        FormatFragmentRecord record{
+            static_cast<uint64_t>(fragment.conversion_type_),
+            fragment.specifier_length_,
+            fragment.format_pos_,
+            fragment.storage_pos_,
+            static_cast<uint32_t>(fragment.fast_format_),
+            fragment.precision_};
+        AppendBytes(dst, record);
+    }
+
+    for (size_t i = 0; i < static_info.num_parameters_; ++i)
+        AppendBytes(dst, static_cast<int32_t>(static_info.param_types_[i]));
+
+    for (size_t i = 0; i < static_info.num_parameters_; ++i)
+        AppendBytes(dst, static_cast<uint64_t>(static_info.param_sizes_[i]));
+}
+
+BinaryLogWriter::BinaryLogWriter()
+    : write_pos_(nullptr),
+      buffer_size_(0),
+      writed_count_(0),
+      entry_head_(),
+      head_pos_(0),
+      body_(nullptr),
+      body_size_(0),
+      body_pos_(0),
+      is_full_(false) {}
+
+void BinaryLogWriter::loadFileHeader() {
+    EntryHeader entry_header{};
+    entry_header.entry_type_ = EntryType::FILE_HEADER;
+    entry_header.payload_size_ = sizeof(FileHeader);
+
+    FileHeader file_header{};
+    memcpy(file_header.magic_, FILE_MAGIC, sizeof(FILE_MAGIC));
+    file_header.version_ = FILE_VERSION;
+    file_header.size_t_size_ = sizeof(size_t);
+
+    entry_head_.clear();
+    AppendBytes(entry_head_, entry_header);
+    AppendBytes(entry_head_, file_header);
+    head_pos_ = 0;
+    body_ = nullptr;
+    body_size_ = body_pos_ = 0;
+}
+
+void BinaryLogWriter::loadStaticInfo(
+    size_t log_id, const log_info::StaticLogInfo* static_info) {
+    SerializeStaticInfo(log_id, *static_info, entry_head_);
+    head_pos_ = 0;
+    body_ = nullptr;
+    body_size_ = body_pos_ = 0;
+}
+
+void BinaryLogWriter::loadCalibration(
+    const utils::TscCalibration& calibration) {
+    EntryHeader entry_header{};
+    entry_header.entry_type_ = EntryType::CALIBRATION;
+    entry_header.payload_size_ = sizeof(CalibrationRecord);
+
+    CalibrationRecord record{calibration.tsc_base_, calibration.ns_base_,
+                             calibration.ns_per_tick_};
+
+    entry_head_.clear();
+    AppendBytes(entry_head_, entry_header);
+    AppendBytes(entry_head_, record);
+    head_pos_ = 0;
+    body_ = nullptr;
+    body_size_ = body_pos_ = 0;
+}
+
+void BinaryLogWriter::loadDynamicInfo(
+    const log_info::DynamicLogInfo* dynamic_info, size_t producer_id) {
+    EntryHeader entry_header{};
+    entry_header.entry_type_ = EntryType::DYNAMIC_INFO;
+    entry_header.producer_id_ = static_cast<uint32_t>(producer_id);
+    entry_header.payload_size_ = dynamic_info->info_size_;
+
+    entry_head_.clear();
+    AppendBytes(entry_head_, entry_header);
+    head_pos_ = 0;
+    body_ = reinterpret_cast<const char*>(dynamic_info);
+    body_size_ = dynamic_info->info_size_;
+    body_pos_ = 0;
+}
+
+size_t BinaryLogWriter::write() noexcept {
+    size_t bytes_writed = 0;
+
+    if (head_pos_ < entry_head_.size()) {
+        size_t tmp = writeAsMuchAsPossible(entry_head_.data() + head_pos_,
+                                           entry_head_.size() - head_pos_);
+        head_pos_ += tmp;
+        bytes_writed += tmp;
+    }
+
+    if (head_pos_ == entry_head_.size() && body_pos_ < body_size_) {
+        size_t tmp = writeAsMuchAsPossible(body_ + body_pos_,
+                                           body_size_ - body_pos_);
+        body_pos_ += tmp;
+        bytes_writed += tmp;
+    }
+
+    is_full_ = hasRemainingData() && getFreeBytes() == 0;
+    return bytes_writed;
+}
+
+BinaryLogReader::LoadedStaticInfo::LoadedStaticInfo(
+    const StaticInfoHeader& header, std::string filename,
+    std::string format_str, std::string conversion_storage,
+    std::vector<log_info::FormatFragment> format_fragments,
+    std::vector<log_info::ParamType> param_types,
+    std::vector<size_t> param_sizes)
+    : filename_(std::move(filename)),
+      format_str_(std::move(format_str)),
+      conversion_storage_(std::move(conversion_storage)),
+      format_fragments_(std::move(format_fragments)),
+      param_types_(std::move(param_types)),
+      param_sizes_(std::move(param_sizes)),
+      info_(filename_.c_str(), header.line_number_,
+            static_cast<log_info::LogLevel>(header.log_level_),
+            header.format_len_, header.num_conversions_,
+            header.num_parameters_, format_str_.data(),
+            conversion_storage_.data(), format_fragments_.data(),
+            param_types_.data(), param_sizes_.data()) {}
+
+BinaryLogReader::BinaryLogReader(FILE* input)
+    : input_(input),
+      has_file_header_(false),
+      static_infos_(),
+      dynamic_info_storage_(),
+      current_log_id_(0),
+      current_producer_id_(0),
+      calibration_() {}
+
+bool BinaryLogReader::readExactly(void* dst, size_t len) {
+    return fread(dst, 1, len, input_) == len;
+}
+
+void BinaryLogReader::readFileHeader(uint64_t payload_size) {
+    FileHeader file_header{};
+    if (payload_size != sizeof(FileHeader) ||
+        !readExactly(&file_header, sizeof(FileHeader)) ||
+        memcmp(file_header.magic_, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+        throw std::runtime_error("Not an OLog binary log file.");
+
+    if (file_header.version_ != FILE_VERSION)
+        throw std::runtime_error("Unsupported OLog binary log version: " +
+                                 std::to_string(file_header.version_));
+
+    if (file_header.size_t_size_ != sizeof(size_t))
+        throw std::runtime_error(
+            "The binary log was written on an incompatible architecture.");
+
+    // 新的文件头之后 log_id 会重新分配。
+    has_file_header_ = true;
+    static_infos_.clear();
+    calibration_ = utils::TscCalibration();
+}
+
+bool BinaryLogReader::readStaticInfo(uint64_t payload_size) {
+    StaticInfoHeader header{};
+    if (payload_size < sizeof(StaticInfoHeader))
+        throw std::runtime_error("Corrupted static info entry.");
+    if (!readExactly(&header, sizeof(StaticInfoHeader)))
+        return false;
+
+    std::string filename(header.filename_len_, '\0');
+    std::string format_str(header.format_len_, '\0');
+    std::string conversion_storage(header.conversion_storage_size_, '\0');
+    if (!readExactly(filename.data(), filename.size()) ||
+        !readExactly(format_str.data(), format_str.size()) ||
+        !readExactly(conversion_storage.data(), conversion_storage.size()))
+        return false;
+
+    std::vector<log_info::FormatFragment> format_fragments;
+    format_fragments.reserve(header.num_conversions_);
+    for (size_t i = 0; i < header.num_conversions_; ++i) {
+        FormatFragmentRecord record{};
+        if (!readExactly(&record, sizeof(record)))
+            return false;
+        format_fragments.push_back(log_info::FormatFragment{
+            static_cast<log_info::ConversionType>(record.conversion_type_),
+            record.specifier_length_, record.format_pos_,
+            record.storage_pos_,
+            static_cast<log_info::FastFormat>(record.fast_format_),
+            record.precision_});
+    }
+
+    std::vector<log_info::ParamType> param_types(header.num_parameters_);
+    for (size_t i = 0; i < header.num_parameters_; ++i) {
+        int32_t param_type = 0;
+        if (!readExactly(&param_type, sizeof(param_type)))
+            return false;
+        param_types[i] = static_cast<log_info::ParamType>(param_type);
+    }
+
+    std::vector<size_t> param_sizes(header.num_parameters_);
+    for (size_t i = 0; i < header.num_parameters_; ++i) {
+        uint64_t param_size = 0;
+        if (!readExactly(&param_size, sizeof(param_size)))
+            return false;
+        param_sizes[i] = param_size;
+    }
+
+    if (header.log_id_ >= static_infos_.size())
+        static_infos_.resize(header.log_id_ + 1);
+    static_infos_[header.log_id_] = std::make_unique<LoadedStaticInfo>(
+        header, std::move(filename), std::move(format_str),
+        std::move(conversion_storage), std::move(format_fragments),
+        std::move(param_types), std::move(param_sizes));
+    return true;
+}
+
+bool BinaryLogReader::readCalibration(uint64_t payload_size) {
+    CalibrationRecord record{};
+    if (payload_size != sizeof(CalibrationRecord))
+        throw std::runtime_error("Corrupted calibration entry.");
+    if (!readExactly(&record, sizeof(record)))
+        return false;
+
+    calibration_.tsc_base_ = record.tsc_base_;
+    calibration_.ns_base_ = record.ns_base_;
+    calibration_.ns_per_tick_ = record.ns_per_tick_;
+    return true;
+}
+
+bool BinaryLogReader::next() {
+    EntryHeader entry_header{};
+    while (readExactly(&entry_header, sizeof(EntryHeader))) {
+        if (!has_file_header_ &&
+            entry_header.entry_type_ != EntryType::FILE_HEADER)
+            throw std::runtime_error("Not an OLog binary log file.");
+
+        switch (entry_header.entry_type_) {
+        case EntryType::FILE_HEADER:
+            readFileHeader(entry_header.payload_size_);
+            break;
+
+        case EntryType::STATIC_INFO:
+            if (!readStaticInfo(entry_header.payload_size_))
+                return false;
+            break;
+
+        case EntryType::CALIBRATION:
+            if (!readCalibration(entry_header.payload_size_))
+                return false;
+            break;
+
+        case EntryType::DYNAMIC_INFO: {
+            if (entry_header.payload_size_ < sizeof(log_info::DynamicLogInfo))
+                throw std::runtime_error("Corrupted dynamic info entry.");
+
+            dynamic_info_storage_.resize(
+                (entry_header.payload_size_ + sizeof(uint64_t) - 1) /
+                sizeof(uint64_t));
+            if (!readExactly(dynamic_info_storage_.data(),
+                             entry_header.payload_size_))
+                return false;
+
+            current_log_id_ = getDynamicInfo()->log_id_;
+            if (current_log_id_ >= static_infos_.size() ||
+                static_infos_[current_log_id_] == nullptr)
+                throw std::runtime_error(
+                    "Dynamic info refers to an unknown log id: " +
+                    std::to_string(current_log_id_));
+
+            current_producer_id_ = entry_header.producer_id_;
+            return true;
+        }
+
+        default:
+            throw std::runtime_error("Unknown entry type in binary log.");
+        }
+    }
+    return false;
+}
+
+}  // namespace binary_log
+}  // namespace olog
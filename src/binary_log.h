@@ -0,0 +1,337 @@
+#ifndef OLOG_BINARY_LOG_H
+#define OLOG_BINARY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log_info.h"
+#include "utils.h"
+
+namespace olog {
+
+/**
+ * binary_log 命名空间下定义了二进制日志文件的格式，
+ * 以及写出和读回二进制日志的工具。
+ *
+ * 二进制日志文件由一系列条目组成，每个条目以 EntryHeader 开头：
+ *   FILE_HEADER   文件头，携带魔数和版本号，总是文件的第一个条目。
+ *                 同一文件中再次出现时（例如进程重启后追加写入），
+ *                 之前读到的静态信息全部作废。
+ *   STATIC_INFO   一条日志静态信息，在引用它的动态信息之前写出。
+ *   DYNAMIC_INFO  一条原样拷贝的 DynamicLogInfo。
+ *   CALIBRATION   时间戳计数器的校准，对之后的 DYNAMIC_INFO 生效。
+ * 所有数值均以本机字节序存储，文件只保证能在相同架构的机器上解码。
+ */
+namespace binary_log {
+
+// 文件头中的魔数。
+static constexpr char FILE_MAGIC[8] = {'O', 'L', 'O', 'G', 'B', 'I', 'N', '\0'};
+
+// 二进制日志格式的版本号。
+static constexpr uint32_t FILE_VERSION = 3;
+
+enum class EntryType : uint32_t {
+    FILE_HEADER = 1,
+    STATIC_INFO = 2,
+    DYNAMIC_INFO = 3,
+    CALIBRATION = 4
+};
+
+struct EntryHeader {
+    // 条目的类型。
+    EntryType entry_type_;
+
+    // 日志来自的生产者编号，仅对 DYNAMIC_INFO 有效。
+    uint32_t producer_id_;
+
+    // 紧跟在头部后面的数据的字节数。
+    uint64_t payload_size_;
+};
+
+struct FileHeader {
+    char magic_[sizeof(FILE_MAGIC)];
+
+    uint32_t version_;
+
+    // 写出文件的机器上 size_t 的大小，用于检查文件能否被解码。
+    uint32_t size_t_size_;
+};
+
+/**
+ * @brief
+ * STATIC_INFO 条目数据的固定部分。
+ * 之后依次跟着：文件名（不含 '\0'）、格式串（format_len_ 字节）、
+ * 格式描述符数组、FormatFragmentRecord 数组、
+ * int32_t 的参数类型数组、uint64_t 的参数大小数组。
+ */
+struct StaticInfoHeader {
+    uint64_t log_id_;
+    uint64_t filename_len_;
+    uint64_t format_len_;
+    uint64_t num_conversions_;
+    uint64_t num_parameters_;
+    uint64_t conversion_storage_size_;
+    uint32_t line_number_;
+    uint32_t log_level_;
+};
+
+// FormatFragment 在文件中的表示。
+struct FormatFragmentRecord {
+    uint64_t conversion_type_;
+    uint64_t specifier_length_;
+    uint64_t format_pos_;
+    uint64_t storage_pos_;
+    uint32_t fast_format_;
+    int32_t precision_;
+};
+
+// utils::TscCalibration 在文件中的表示，即 CALIBRATION 条目的数据。
+struct CalibrationRecord {
+    uint64_t tsc_base_;
+    int64_t ns_base_;
+    double ns_per_tick_;
+};
+
+/**
+ * @brief
+ * 计算静态信息中格式描述符数组的大小。
+ * 数组中的每个格式描述符后面都跟着一个 '\0'。
+ *
+ * @param static_info
+ * @return size_t
+ */
+size_t GetConversionStorageSize(const log_info::StaticLogInfo& static_info);
+
+/**
+ * @brief
+ * 将一条静态信息序列化为完整的 STATIC_INFO 条目（包含 EntryHeader）。
+ *
+ * @param log_id 静态信息对应的 id。
+ * @param static_info 被序列化的静态信息。
+ * @param dst 存放结果的字符串，原有内容会被清除。
+ */
+void SerializeStaticInfo(size_t log_id,
+                         const log_info::StaticLogInfo& static_info,
+                         std::string& dst);
+
+/**
+ * @brief
+ * BinaryLogWriter 与 LogAssembler 的接口相同，
+ * 但它不对日志进行格式化，而是将条目原样写入缓冲区。
+ * 二进制日志是连续的字节流，所以一个条目可以被拆分到两个缓冲区中，
+ * 缓冲区总是会被完全写满。
+ */
+class BinaryLogWriter {
+  public:
+    BinaryLogWriter();
+
+    ~BinaryLogWriter() = default;
+
+    BinaryLogWriter(const BinaryLogWriter&) = delete;
+
+    BinaryLogWriter(BinaryLogWriter&&) = delete;
+
+    inline void setBuffer(char* write_pos, size_t buffer_size) {
+        write_pos_ = write_pos;
+        buffer_size_ = buffer_size;
+        writed_count_ = 0;
+        is_full_ = false;
+    }
+
+    /**
+     * @brief 装载文件头。
+     */
+    void loadFileHeader();
+
+    /**
+     * @brief 装载一条日志静态信息。
+     *
+     * @param log_id 静态信息对应的 id。
+     * @param static_info
+     */
+    void loadStaticInfo(size_t log_id,
+                        const log_info::StaticLogInfo* static_info);
+
+    /**
+     * @brief 装载时间戳计数器的校准。
+     *
+     * @param calibration
+     */
+    void loadCalibration(const utils::TscCalibration& calibration);
+
+    /**
+     * @brief 装载一条日志动态信息。
+     *
+     * @param dynamic_info
+     * 在该条目被完全写出之前，dynamic_info 指向的内存必须保持有效。
+     * @param producer_id 日志来自的生产者编号。
+     */
+    void loadDynamicInfo(const log_info::DynamicLogInfo* dynamic_info,
+                         size_t producer_id);
+
+    /**
+     * @brief 进行一次写入操作。
+     *
+     * @return 写入缓冲区的字节数。
+     */
+    size_t write() noexcept;
+
+    inline bool hasRemainingData() const {
+        return head_pos_ < entry_head_.size() || body_pos_ < body_size_;
+    }
+
+    inline size_t getWritedBytes() const { return writed_count_; }
+
+    inline size_t getFreeBytes() const { return buffer_size_ - writed_count_; }
+
+    inline bool isBufferFull() const { return is_full_; }
+
+  private:
+    /**
+     * @brief
+     * 尽可能多地将 [src, src + len) 写入缓冲区。
+     *
+     * @return 写入的字节数。
+     */
+    inline size_t writeAsMuchAsPossible(const char* src, size_t len) noexcept {
+        size_t n = len < getFreeBytes() ? len : getFreeBytes();
+        memcpy(write_pos_, src, n);
+        write_pos_ += n;
+        writed_count_ += n;
+        return n;
+    }
+
+  private:
+    char* write_pos_;
+    size_t buffer_size_;
+
+    // 向缓冲区已经写入的字节总数。
+    size_t writed_count_;
+
+    // 条目的头部。对于 STATIC_INFO 和 FILE_HEADER，整个条目都存放在这里。
+    std::string entry_head_;
+
+    // entry_head_ 中已写出的字节数。
+    size_t head_pos_;
+
+    // 条目中直接从原位置拷贝的部分，即 DynamicLogInfo 本身。
+    const char* body_;
+
+    size_t body_size_;
+
+    // body_ 中已写出的字节数。
+    size_t body_pos_;
+
+    // 指示写缓冲区是否已满。
+    bool is_full_;
+};
+
+/**
+ * @brief
+ * 从二进制日志文件中逐条读回日志。
+ * 读回的静态信息和动态信息可以直接交给 LogAssembler 恢复为文本。
+ */
+class BinaryLogReader {
+  public:
+    /**
+     * @param input 以二进制方式打开的日志文件，由调用者负责关闭。
+     */
+    explicit BinaryLogReader(FILE* input);
+
+    ~BinaryLogReader() = default;
+
+    BinaryLogReader(const BinaryLogReader&) = delete;
+
+    BinaryLogReader(BinaryLogReader&&) = delete;
+
+    /**
+     * @brief
+     * 读取下一条日志。
+     *
+     * @return 读到日志时返回 true；到达文件结尾，或文件尾部的条目
+     * 不完整（例如进程崩溃时写入被中断）时返回 false。
+     *
+     * @throw std::runtime_error 文件不是 OLog 的二进制日志或内容已损坏。
+     */
+    bool next();
+
+    inline const log_info::StaticLogInfo* getStaticInfo() const {
+        return &static_infos_[current_log_id_]->info_;
+    }
+
+    inline const log_info::DynamicLogInfo* getDynamicInfo() const {
+        return reinterpret_cast<const log_info::DynamicLogInfo*>(
+            dynamic_info_storage_.data());
+    }
+
+    inline uint32_t getProducerId() const { return current_producer_id_; }
+
+    /**
+     * @brief 获取当前动态信息所对应的时间戳计数器校准。
+     */
+    inline const utils::TscCalibration& getCalibration() const {
+        return calibration_;
+    }
+
+  private:
+    /**
+     * @brief 反序列化后的静态信息及其引用的各个数组。
+     */
+    struct LoadedStaticInfo {
+        explicit LoadedStaticInfo(
+            const StaticInfoHeader& header, std::string filename,
+            std::string format_str, std::string conversion_storage,
+            std::vector<log_info::FormatFragment> format_fragments,
+            std::vector<log_info::ParamType> param_types,
+            std::vector<size_t> param_sizes);
+
+        std::string filename_;
+        std::string format_str_;
+        std::string conversion_storage_;
+        std::vector<log_info::FormatFragment> format_fragments_;
+        std::vector<log_info::ParamType> param_types_;
+        std::vector<size_t> param_sizes_;
+        log_info::StaticLogInfo info_;
+    };
+
+    /**
+     * @brief 从文件中读出指定字节数。
+     *
+     * @return 读满 len 字节时返回 true。
+     */
+    bool readExactly(void* dst, size_t len);
+
+    void readFileHeader(uint64_t payload_size);
+
+    bool readStaticInfo(uint64_t payload_size);
+
+    bool readCalibration(uint64_t payload_size);
+
+  private:
+    FILE* input_;
+
+    // 是否已经读到过文件头。
+    bool has_file_header_;
+
+    // 以 log_id 为下标的静态信息。
+    std::vector<std::unique_ptr<LoadedStaticInfo>> static_infos_;
+
+    // 存放当前动态信息的内存，使用 uint64_t 保证对齐。
+    std::vector<uint64_t> dynamic_info_storage_;
+
+    size_t current_log_id_;
+
+    uint32_t current_producer_id_;
+
+    utils::TscCalibration calibration_;
+};
+
+}  // namespace binary_log
+}  // namespace olog
+
+#endif
@@ -8,54 +8,70 @@ StagingBuffer::DestructGuard::DestructGuard()
 
 StagingBuffer::DestructGuard::~DestructGuard() {
     if (staging_buffer_ != nullptr) {
-        staging_buffer_->should_be_destructed_ = true;
+        staging_buffer_->should_be_destructed_.store(
+            true, std::memory_order_release);
         staging_buffer_ = nullptr;
     }
 }
 
 char* StagingBuffer::peek(size_t& available_bytes) {
-    char* cached_producer_pos = producer_pos_;
+    char* consumer_pos = consumer_pos_.load(std::memory_order_relaxed);
 
-    if (cached_producer_pos < consumer_pos_) {
-        available_bytes = end_of_data_ - consumer_pos_;
+    // 缓存的生产者位置之前已没有可读数据时，才重新读取生产者的位置。
+    if (cached_producer_pos_ == consumer_pos)
+        cached_producer_pos_ = producer_pos_.load(std::memory_order_acquire);
+
+    if (cached_producer_pos_ < consumer_pos) {
+        available_bytes =
+            end_of_data_.load(std::memory_order_relaxed) - consumer_pos;
 
         if (available_bytes > 0)
-            return consumer_pos_;
+            return consumer_pos;
+
+        consumer_pos = storage.get();
+        consumer_pos_.store(consumer_pos, std::memory_order_release);
 
-        consumer_pos_ = storage.get();
+        if (cached_producer_pos_ == consumer_pos)
+            cached_producer_pos_ =
+                producer_pos_.load(std::memory_order_acquire);
     }
 
-    available_bytes = cached_producer_pos - consumer_pos_;
-    return consumer_pos_;
+    available_bytes = cached_producer_pos_ - consumer_pos;
+    return consumer_pos;
 }
 
-char* StagingBuffer::reserveProducerSpaceInternal(size_t num_bytes, bool blocking) {
+char* StagingBuffer::reserveProducerSpaceInternal(size_t num_bytes,
+                                                  bool blocking) {
     const char* end_of_storage = storage.get() + capacity_;
+    char* producer_pos = producer_pos_.load(std::memory_order_relaxed);
 
     while (available_bytes_ <= num_bytes) {
-        char* cached_consumer_pos = consumer_pos_;
+        char* cached_consumer_pos =
+            consumer_pos_.load(std::memory_order_acquire);
 
-        if (cached_consumer_pos <= producer_pos_) {
-            available_bytes_ = end_of_storage - producer_pos_;
+        if (cached_consumer_pos <= producer_pos) {
+            available_bytes_ = end_of_storage - producer_pos;
 
             if (available_bytes_ > num_bytes)
-                return producer_pos_;
+                return producer_pos;
 
-            end_of_data_ = producer_pos_;
+            end_of_data_.store(producer_pos, std::memory_order_relaxed);
 
             if (cached_consumer_pos != storage.get()) {
-                producer_pos_ = storage.get();
-                available_bytes_ = cached_consumer_pos - producer_pos_;
+                // 回到缓冲区起始位置，同时发布 end_of_data_。
+                producer_pos = storage.get();
+                producer_pos_.store(producer_pos, std::memory_order_release);
+                available_bytes_ = cached_consumer_pos - producer_pos;
             }
         } else {
-            available_bytes_ = cached_consumer_pos - consumer_pos_;
+            available_bytes_ = cached_consumer_pos - producer_pos;
         }
 
         if (!blocking && available_bytes_ <= num_bytes)
             return nullptr;
     }
 
-    return producer_pos_;
+    return producer_pos;
 }
 
 }  // namespace buffers
@@ -1,20 +1,30 @@
 #ifndef OLOG_BUFFERS_H
 #define OLOG_BUFFERS_H
 
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <system_error>
 
 namespace olog {
 namespace buffers {
 
+// 缓存行大小。生产者和消费者各自更新的属性被放在不同的缓存行中，避免伪共享。
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
 /**
  * @brief
  * 支持单生产者单消费者的无锁循环队列。
  * 用于在工作线程和日志线程之间传递日志的动态信息。
  * 每个工作线程都有自己的一个缓冲区（被 thread_local 修饰）。
+ *
+ * 生产者以 release 语义发布 producer_pos_，消费者以 acquire 语义读取，
+ * 保证消费者读到的数据已被完整写入；consume 以 release 语义发布
+ * consumer_pos_，保证生产者覆盖数据之前消费者已经读完。
+ * 双方都缓存对方的位置，只在缓存的信息不够用时才访问对方的缓存行。
  */
 class StagingBuffer {
   public:
@@ -59,11 +69,14 @@ class StagingBuffer {
                            StagingBuffer::DestructGuard& destruct_guard)
         : producer_pos_(nullptr),
           end_of_data_(nullptr),
+          available_bytes_(capacity),
+          num_dropped_records_(0),
           consumer_pos_(nullptr),
+          cached_producer_pos_(nullptr),
+          num_reported_dropped_records_(0),
           buffer_id_(buffer_id),
           should_be_destructed_(false),
           capacity_(capacity),
-          available_bytes_(capacity),
           storage(nullptr) {
         destruct_guard.bind(this);
         storage = std::make_unique<char[]>(capacity_);
@@ -71,9 +84,11 @@ class StagingBuffer {
             throw std::system_error(
                 errno, std::generic_category(),
                 "StagingBuffer: Can't allocate space for StagingBuffer.");
-        producer_pos_ = storage.get();
-        end_of_data_ = storage.get() + capacity_;
-        consumer_pos_ = storage.get();
+        producer_pos_.store(storage.get(), std::memory_order_relaxed);
+        end_of_data_.store(storage.get() + capacity_,
+                           std::memory_order_relaxed);
+        consumer_pos_.store(storage.get(), std::memory_order_relaxed);
+        cached_producer_pos_ = storage.get();
     }
 
     ~StagingBuffer() {}
@@ -88,16 +103,16 @@ class StagingBuffer {
      * 当可分配空间不足时，该方法会使生产者线程自旋等待消费者腾出空间。
      *
      * @param num_bytes 请求的字节数。
-     * @param blocking
+     * @param blocking 为 false 时空间不足则立即返回 nullptr，不进行等待。
      * @return char* 指向写入位置的指针。
      */
     inline char* reserveProducerSpace(size_t num_bytes, bool blocking = true) {
         // 该断言失败会导致死循环。
         assert(num_bytes < capacity_ || !blocking);
 
-        // 如果剩余空间足够则直接分配。
+        // 如果剩余空间足够则直接分配，不需要读取消费者的位置。
         if (num_bytes < available_bytes_)
-            return producer_pos_;
+            return producer_pos_.load(std::memory_order_relaxed);
 
         // 剩余空间不足则等待消费者以获取空间。
         return reserveProducerSpaceInternal(num_bytes, blocking);
@@ -111,11 +126,15 @@ class StagingBuffer {
      * @param num_bytes 已写入的字节数。
      */
     inline void finishReservation(size_t num_bytes) {
+        char* producer_pos = producer_pos_.load(std::memory_order_relaxed);
         assert(num_bytes < available_bytes_);
-        assert(producer_pos_ + num_bytes < storage.get() + capacity_);
+        assert(producer_pos + num_bytes < storage.get() + capacity_);
 
         available_bytes_ -= num_bytes;
-        producer_pos_ += num_bytes;
+
+        // 发布写入的数据。
+        producer_pos_.store(producer_pos + num_bytes,
+                            std::memory_order_release);
     }
 
     /**
@@ -138,16 +157,44 @@ class StagingBuffer {
      * @param num_bytes 已读出的字节数。
      */
     inline void consume(size_t num_bytes) {
-        assert(consumer_pos_ + num_bytes < storage.get() + capacity_);
+        char* consumer_pos = consumer_pos_.load(std::memory_order_relaxed);
+        assert(consumer_pos + num_bytes < storage.get() + capacity_);
 
-        // fence
-        consumer_pos_ += num_bytes;
+        // 数据读完后才允许生产者覆盖这段空间。
+        consumer_pos_.store(consumer_pos + num_bytes,
+                            std::memory_order_release);
+    }
+
+    /**
+     * @brief
+     * 记录一条因空间不足而被生产者丢弃的日志。该方法由生产者调用。
+     */
+    inline void addDroppedRecord() {
+        num_dropped_records_.store(
+            num_dropped_records_.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 获取自上次调用以来生产者新丢弃的日志数量。该方法由消费者调用。
+     *
+     * @return uint64_t
+     */
+    inline uint64_t takeDroppedRecords() {
+        uint64_t num_dropped =
+            num_dropped_records_.load(std::memory_order_relaxed);
+        uint64_t num_new = num_dropped - num_reported_dropped_records_;
+        num_reported_dropped_records_ = num_dropped;
+        return num_new;
     }
 
     inline uint32_t getId() const { return buffer_id_; }
 
     inline bool shouldBeDestructed() const {
-        return should_be_destructed_ && consumer_pos_ == producer_pos_;
+        return should_be_destructed_.load(std::memory_order_acquire) &&
+               consumer_pos_.load(std::memory_order_relaxed) ==
+                   producer_pos_.load(std::memory_order_acquire);
     }
 
     inline size_t getCapacity() const { return capacity_; }
@@ -163,32 +210,51 @@ class StagingBuffer {
     char* reserveProducerSpaceInternal(size_t num_bytes, bool blocking = true);
 
   private:
+    // 以下属性由生产者更新。
+
     // 指向生产者写入位置的指针。
     // 该属性只允许被生产者更新。消费者会只读该属性，用来更新可读字节数。
-    char* volatile producer_pos_;
+    alignas(CACHE_LINE_SIZE) std::atomic<char*> producer_pos_;
 
     // 在 producer_pos_ 指回缓冲区起始位置时，该属性指向已写入数据的尾部。
     // 该属性只允许被生产者更新，用于指示消费者可读的结尾。
-    char* volatile end_of_data_;
+    // 它在 producer_pos_ 被发布之前写入，所以可以使用 relaxed 语义。
+    std::atomic<char*> end_of_data_;
+
+    // 可用的字节数，即生产者对消费者位置的缓存。
+    // 该属性只允许被生产者访问。
+    size_t available_bytes_;
+
+    // 生产者因空间不足而丢弃的日志总数。
+    // 该属性只允许被生产者更新，消费者只读该属性。
+    std::atomic<uint64_t> num_dropped_records_;
+
+    // 以下属性由消费者更新。
 
     // 指向消费者读出位置的指针。
     // 该属性只允许被消费者更新。生产者会只读该属性，用来更新可用字节数;
-    char* volatile consumer_pos_;
+    alignas(CACHE_LINE_SIZE) std::atomic<char*> consumer_pos_;
+
+    // 消费者对 producer_pos_ 的缓存。
+    // 该属性只允许被消费者访问。
+    char* cached_producer_pos_;
+
+    // 消费者已经报告过的丢弃日志数量。
+    // 该属性只允许被消费者访问。
+    uint64_t num_reported_dropped_records_;
+
+    // 以下属性在构造后不再改变，或很少被访问。
 
     // 为每个对象分配的 id。
     // 当每个线程各拥有一个 StagingBuffer 对象时，该属性也是对线程的一个标记。
-    uint32_t buffer_id_;
+    alignas(CACHE_LINE_SIZE) uint32_t buffer_id_;
 
     // 指示是否可以析构该对象。
-    bool should_be_destructed_;
+    std::atomic<bool> should_be_destructed_;
 
     // 缓冲区的容量。
     size_t capacity_;
 
-    // 可用的字节数。
-    // 该属性只允许被生产者更新。
-    size_t available_bytes_;
-
     // 指向缓冲区的指针。
     std::unique_ptr<char[]> storage;
 };
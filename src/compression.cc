@@ -0,0 +1,216 @@
+#include "compression.h"
+
+#include <cassert>
+#include <cstring>
+
+#ifdef OLOG_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace olog {
+namespace compression {
+
+uint32_t Checksum(const char* data, size_t nbytes) {
+    // 以 8 字节为单位的 FNV-1a，比逐字节计算快得多，足以发现不完整的写入。
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ nbytes;
+    size_t pos = 0;
+    for (; pos + sizeof(uint64_t) <= nbytes; pos += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + pos, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; pos < nbytes; ++pos)
+        hash = (hash ^ static_cast<unsigned char>(data[pos])) * prime;
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+size_t NoopCompressor::compress(const char* src, size_t nbytes, char* dst,
+                                size_t capacity) {
+    if (nbytes > capacity)
+        return 0;
+    memcpy(dst, src, nbytes);
+    return nbytes;
+}
+
+bool NoopCompressor::decompress(const char* src, size_t nbytes, char* dst,
+                                size_t capacity) {
+    if (nbytes != capacity)
+        return false;
+    memcpy(dst, src, nbytes);
+    return true;
+}
+
+#ifdef OLOG_WITH_ZSTD
+size_t ZstdCompressor::compress(const char* src, size_t nbytes, char* dst,
+                                size_t capacity) {
+    size_t ret = ZSTD_compress(dst, capacity, src, nbytes, level_);
+    return ZSTD_isError(ret) ? 0 : ret;
+}
+
+bool ZstdCompressor::decompress(const char* src, size_t nbytes, char* dst,
+                                size_t capacity) {
+    size_t ret = ZSTD_decompress(dst, capacity, src, nbytes);
+    return !ZSTD_isError(ret) && ret == capacity;
+}
+#endif
+
+size_t EncodeFrame(Compressor& compressor, const char* src, size_t nbytes,
+                   char* dst) {
+    FrameHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    header.uncompressed_size_ = static_cast<uint32_t>(nbytes);
+
+    // 压缩结果不比原始数据小时没有意义，直接存储原始数据。
+    char* payload = dst + sizeof(FrameHeader);
+    size_t compressed_size = 0;
+    if (nbytes > 0)
+        compressed_size = compressor.compress(src, nbytes, payload, nbytes - 1);
+    if (compressed_size > 0) {
+        header.codec_ = compressor.getCodec();
+    } else {
+        header.codec_ = CODEC_NONE;
+        memcpy(payload, src, nbytes);
+        compressed_size = nbytes;
+    }
+
+    header.compressed_size_ = static_cast<uint32_t>(compressed_size);
+    header.checksum_ = Checksum(payload, compressed_size);
+    memcpy(dst, &header, sizeof(header));
+    return sizeof(FrameHeader) + compressed_size;
+}
+
+FrameReader::FrameReader(FILE* input) : input_(input), is_complete_(false) {
+    registerCompressor(std::make_unique<NoopCompressor>());
+#ifdef OLOG_WITH_ZSTD
+    registerCompressor(std::make_unique<ZstdCompressor>());
+#endif
+}
+
+void FrameReader::registerCompressor(std::unique_ptr<Compressor> compressor) {
+    uint8_t codec = compressor->getCodec();
+    if (codec >= compressors_.size())
+        compressors_.resize(codec + 1);
+    compressors_[codec] = std::move(compressor);
+}
+
+bool FrameReader::next() {
+    data_.clear();
+
+    FrameHeader header;
+    size_t nread = fread(&header, 1, sizeof(header), input_);
+    is_complete_ = nread == 0;
+    if (nread != sizeof(header))
+        return false;
+
+    // 崩溃前没有写到的帧通常是空洞，读出来全是 0。
+    if (memcmp(header.magic_, FRAME_MAGIC, sizeof(FRAME_MAGIC)) != 0 ||
+        header.codec_ >= compressors_.size() ||
+        compressors_[header.codec_] == nullptr ||
+        header.compressed_size_ > MAX_FRAME_SIZE ||
+        header.uncompressed_size_ > MAX_FRAME_SIZE)
+        return false;
+
+    payload_.resize(header.compressed_size_);
+    nread = fread(payload_.data(), 1, payload_.size(), input_);
+    if (nread != payload_.size() ||
+        Checksum(payload_.data(), payload_.size()) != header.checksum_)
+        return false;
+
+    data_.resize(header.uncompressed_size_);
+    if (!compressors_[header.codec_]->decompress(
+            payload_.data(), payload_.size(), data_.data(), data_.size())) {
+        data_.clear();
+        return false;
+    }
+    return true;
+}
+
+CompressionWorker::CompressionWorker(std::function<void()> on_finished)
+    : on_finished_(std::move(on_finished)),
+      num_started_(0),
+      should_exit_(false) {
+    worker_thread_ = std::thread(&CompressionWorker::workerThreadMain, this);
+}
+
+CompressionWorker::~CompressionWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        should_exit_ = true;
+    }
+    job_cv_.notify_one();
+    if (worker_thread_.joinable())
+        worker_thread_.join();
+}
+
+void CompressionWorker::setCompressor(std::unique_ptr<Compressor> compressor) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    assert(jobs_.empty());
+    compressor_ = std::move(compressor);
+}
+
+void CompressionWorker::submit(size_t id, const char* src, size_t nbytes,
+                               char* dst) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        jobs_.push_back(Job{id, src, nbytes, dst, 0, false});
+    }
+    job_cv_.notify_one();
+}
+
+bool CompressionWorker::takeFinished(size_t& id, size_t& frame_size,
+                                     bool wait) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (jobs_.empty())
+        return false;
+    if (!jobs_.front().finished_) {
+        if (!wait)
+            return false;
+        finished_cv_.wait(lock, [this] { return jobs_.front().finished_; });
+    }
+
+    id = jobs_.front().id_;
+    frame_size = jobs_.front().frame_size_;
+    jobs_.pop_front();
+    --num_started_;
+    return true;
+}
+
+bool CompressionWorker::hasPendingJobs() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return !jobs_.empty();
+}
+
+bool CompressionWorker::hasFinishedJobs() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return !jobs_.empty() && jobs_.front().finished_;
+}
+
+void CompressionWorker::workerThreadMain() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true) {
+        job_cv_.wait(lock, [this] {
+            return should_exit_ || num_started_ < jobs_.size();
+        });
+        if (should_exit_)
+            break;
+
+        // 任务在完成并被取出之前不会从 jobs_ 中移除。
+        Job& job = jobs_[num_started_++];
+        lock.unlock();
+        size_t frame_size =
+            EncodeFrame(*compressor_, job.src_, job.nbytes_, job.dst_);
+        lock.lock();
+        job.frame_size_ = frame_size;
+        job.finished_ = true;
+        lock.unlock();
+
+        finished_cv_.notify_all();
+        on_finished_();
+        lock.lock();
+    }
+}
+
+}  // namespace compression
+}  // namespace olog
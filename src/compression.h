@@ -0,0 +1,326 @@
+#ifndef OLOG_COMPRESSION_H
+#define OLOG_COMPRESSION_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace olog {
+
+/**
+ * compression 命名空间下定义了压缩日志文件的帧格式、可替换的压缩器，
+ * 以及在日志线程之外压缩输出缓冲区的压缩线程。
+ *
+ * 压缩后的日志文件由一系列帧组成，每个帧独立压缩一个输出缓冲区的内容，
+ * 以 FrameHeader 开头，之后是压缩后的数据。帧之间没有依赖，
+ * 所以进程崩溃时写了一半的文件仍可以读到最后一个完整的帧为止。
+ * 所有数值均以本机字节序存储。
+ */
+namespace compression {
+
+// 帧头中的魔数。
+static constexpr char FRAME_MAGIC[4] = {'O', 'L', 'Z', 'F'};
+
+// 内置压缩器的编号。自定义的压缩器应当使用 128 及以上的编号。
+static constexpr uint8_t CODEC_NONE = 0;
+static constexpr uint8_t CODEC_ZSTD = 1;
+
+// 读取时接受的最大帧长度，超过时认为文件已经损坏。
+static constexpr uint32_t MAX_FRAME_SIZE = 1024 * 1024 * 1024;
+
+struct FrameHeader {
+    char magic_[sizeof(FRAME_MAGIC)];
+
+    // 压缩数据所使用的压缩器编号。
+    uint8_t codec_;
+
+    uint8_t reserved_[3];
+
+    // 压缩前的字节数。
+    uint32_t uncompressed_size_;
+
+    // 紧跟在帧头后面的压缩数据的字节数。
+    uint32_t compressed_size_;
+
+    // 压缩数据的校验和，用于发现写了一半的帧。
+    uint32_t checksum_;
+};
+
+/**
+ * @brief
+ * 计算帧中压缩数据的校验和。
+ *
+ * @param data
+ * @param nbytes
+ * @return uint32_t
+ */
+uint32_t Checksum(const char* data, size_t nbytes);
+
+/**
+ * @brief
+ * 压缩器的接口。Logger 只在压缩线程中调用 compress，
+ * FrameReader 使用编号相同的压缩器的 decompress 恢复数据。
+ */
+class Compressor {
+  public:
+    virtual ~Compressor() = default;
+
+    /**
+     * @brief 获取写入帧头的压缩器编号。
+     */
+    virtual uint8_t getCodec() const = 0;
+
+    /**
+     * @brief
+     * 压缩 [src, src + nbytes)。
+     *
+     * @param dst 存放压缩结果的位置。
+     * @param capacity dst 的大小。
+     * @return 压缩后的字节数。失败或结果放不下时返回 0，此时帧中存储原始数据。
+     */
+    virtual size_t compress(const char* src, size_t nbytes, char* dst,
+                            size_t capacity) = 0;
+
+    /**
+     * @brief
+     * 恢复 compress 压缩的数据。
+     *
+     * @param dst 存放恢复结果的位置。
+     * @param capacity dst 的大小，即压缩前的字节数。
+     * @return 恢复的数据与 capacity 相同时返回 true。
+     */
+    virtual bool decompress(const char* src, size_t nbytes, char* dst,
+                            size_t capacity) = 0;
+};
+
+/**
+ * @brief
+ * 不进行压缩的压缩器，帧中存储原始数据。
+ */
+class NoopCompressor : public Compressor {
+  public:
+    uint8_t getCodec() const override { return CODEC_NONE; }
+
+    size_t compress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override;
+
+    bool decompress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override;
+};
+
+#ifdef OLOG_WITH_ZSTD
+/**
+ * @brief
+ * 使用 zstd 压缩。构建时找到 zstd 才可用。
+ */
+class ZstdCompressor : public Compressor {
+  public:
+    /**
+     * @param level zstd 的压缩等级。日志线程写出的速度通常更重要，默认为 1。
+     */
+    explicit ZstdCompressor(int level = 1) : level_(level) {}
+
+    uint8_t getCodec() const override { return CODEC_ZSTD; }
+
+    size_t compress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override;
+
+    bool decompress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override;
+
+  private:
+    int level_;
+};
+#endif
+
+/**
+ * @brief
+ * 计算 nbytes 字节的数据编码为帧后的最大长度。
+ */
+inline size_t GetMaxFrameSize(size_t nbytes) {
+    return sizeof(FrameHeader) + nbytes;
+}
+
+/**
+ * @brief
+ * 将 [src, src + nbytes) 压缩为一个完整的帧。
+ * 压缩失败或没有变小时，帧中存储原始数据，编号为 CODEC_NONE。
+ *
+ * @param compressor
+ * @param dst 存放帧的位置，至少有 GetMaxFrameSize(nbytes) 字节。
+ * @return 帧的字节数。
+ */
+size_t EncodeFrame(Compressor& compressor, const char* src, size_t nbytes,
+                   char* dst);
+
+/**
+ * @brief
+ * 从压缩后的日志文件中逐帧读回数据。
+ * 内置的压缩器已经注册，自定义的压缩器需要通过 registerCompressor 注册。
+ */
+class FrameReader {
+  public:
+    /**
+     * @param input 以二进制方式打开的日志文件，由调用者负责关闭。
+     */
+    explicit FrameReader(FILE* input);
+
+    ~FrameReader() = default;
+
+    FrameReader(const FrameReader&) = delete;
+
+    FrameReader(FrameReader&&) = delete;
+
+    /**
+     * @brief
+     * 注册用于恢复数据的压缩器，替换编号相同的压缩器。
+     *
+     * @param compressor
+     */
+    void registerCompressor(std::unique_ptr<Compressor> compressor);
+
+    /**
+     * @brief
+     * 读取下一个帧并恢复其中的数据。
+     *
+     * @return 读到完整的帧时返回 true；到达文件结尾，或遇到不完整、
+     * 损坏的帧（例如进程崩溃时写入被中断）时返回 false，
+     * 可以通过 isComplete 区分。
+     */
+    bool next();
+
+    /**
+     * @brief 上一次 next 返回 false 时，是否是因为到达了文件结尾。
+     */
+    inline bool isComplete() const { return is_complete_; }
+
+    inline const char* getData() const { return data_.data(); }
+
+    inline size_t getSize() const { return data_.size(); }
+
+  private:
+    FILE* input_;
+
+    // 以编号为下标的压缩器。
+    std::vector<std::unique_ptr<Compressor>> compressors_;
+
+    // 当前帧中的压缩数据。
+    std::vector<char> payload_;
+
+    // 当前帧恢复后的数据。
+    std::vector<char> data_;
+
+    bool is_complete_;
+};
+
+/**
+ * @brief
+ * 在后台线程中将输出缓冲区压缩为帧。
+ * 任务按提交的顺序压缩，也按提交的顺序取出，
+ * 写出帧的线程因此可以按原来的顺序决定各个帧在文件中的位置。
+ */
+class CompressionWorker {
+  public:
+    /**
+     * @param on_finished 每个任务完成后在压缩线程中调用，
+     * 用于唤醒取出任务的线程。
+     */
+    explicit CompressionWorker(std::function<void()> on_finished);
+
+    ~CompressionWorker();
+
+    CompressionWorker(const CompressionWorker&) = delete;
+
+    CompressionWorker(CompressionWorker&&) = delete;
+
+    /**
+     * @brief
+     * 更换压缩器。只能在没有未取出的任务时调用。
+     *
+     * @param compressor
+     */
+    void setCompressor(std::unique_ptr<Compressor> compressor);
+
+    /**
+     * @brief
+     * 提交一个压缩任务。在任务被取出之前，src 和 dst 指向的内存必须保持有效。
+     *
+     * @param id 任务的编号，取出时原样返回。
+     * @param src 要压缩的数据。
+     * @param nbytes 要压缩的字节数。
+     * @param dst 存放帧的位置，至少有 GetMaxFrameSize(nbytes) 字节。
+     */
+    void submit(size_t id, const char* src, size_t nbytes, char* dst);
+
+    /**
+     * @brief
+     * 取出最早提交的任务。
+     *
+     * @param id 任务的编号。
+     * @param frame_size 帧的字节数。
+     * @param wait 该任务尚未完成时是否等待。
+     * @return 取出任务时返回 true；没有任务，
+     * 或不等待且任务尚未完成时返回 false。
+     */
+    bool takeFinished(size_t& id, size_t& frame_size, bool wait);
+
+    /**
+     * @brief 检查是否有未取出的任务。
+     */
+    bool hasPendingJobs();
+
+    /**
+     * @brief 检查最早提交的任务是否已经完成，可以不等待地取出。
+     */
+    bool hasFinishedJobs();
+
+  private:
+    struct Job {
+        size_t id_;
+        const char* src_;
+        size_t nbytes_;
+        char* dst_;
+        size_t frame_size_;
+        bool finished_;
+    };
+
+    void workerThreadMain();
+
+  private:
+    std::function<void()> on_finished_;
+
+    // 只在没有任务时被更换，压缩线程在锁外使用它。
+    std::unique_ptr<Compressor> compressor_;
+
+    // 对以下属性进行保护。
+    std::mutex mtx_;
+
+    // 有新任务或应当退出时通知压缩线程。
+    std::condition_variable job_cv_;
+
+    // 任务完成时通知等待的线程。
+    std::condition_variable finished_cv_;
+
+    // 未取出的任务。std::deque 在两端增删时不会移动其他元素，
+    // 压缩线程可以在锁外访问正在压缩的任务。
+    std::deque<Job> jobs_;
+
+    // jobs_ 开头已经开始压缩的任务数量。
+    size_t num_started_;
+
+    bool should_exit_;
+
+    std::thread worker_thread_;
+};
+
+}  // namespace compression
+}  // namespace olog
+
+#endif
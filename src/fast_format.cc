@@ -0,0 +1,126 @@
+#include "fast_format.h"
+
+#include <charconv>
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+
+namespace olog {
+namespace fast_format {
+
+namespace {
+
+// 0 到 99 的两位十进制表示，每次转换两位数字以减少除法次数。
+const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+const char LOWER_HEX_DIGITS[] = "0123456789abcdef";
+
+const char UPPER_HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * @brief 计算无符号整数的十进制位数。
+ */
+inline size_t CountDecimalDigits(uint64_t val) {
+    size_t num_digits = 1;
+    while (true) {
+        if (val < 10)
+            return num_digits;
+        if (val < 100)
+            return num_digits + 1;
+        if (val < 1000)
+            return num_digits + 2;
+        if (val < 10000)
+            return num_digits + 3;
+        val /= 10000;
+        num_digits += 4;
+    }
+}
+
+}  // namespace
+
+size_t FormatUnsignedDecimal(char* dst, uint64_t val) noexcept {
+    size_t len = CountDecimalDigits(val);
+
+    // 从后向前写入。
+    char* pos = dst + len;
+    while (val >= 100) {
+        size_t pair_index = (val % 100) * 2;
+        val /= 100;
+        pos -= 2;
+        memcpy(pos, DIGIT_PAIRS + pair_index, 2);
+    }
+    if (val >= 10) {
+        pos -= 2;
+        memcpy(pos, DIGIT_PAIRS + val * 2, 2);
+    } else {
+        *--pos = static_cast<char>('0' + val);
+    }
+    return len;
+}
+
+size_t FormatSignedDecimal(char* dst, int64_t val) noexcept {
+    if (val >= 0)
+        return FormatUnsignedDecimal(dst, static_cast<uint64_t>(val));
+
+    // 先转换为无符号数再取反，避免对 INT64_MIN 取反溢出。
+    *dst = '-';
+    return 1 + FormatUnsignedDecimal(dst + 1, 0 - static_cast<uint64_t>(val));
+}
+
+size_t FormatHex(char* dst, uint64_t val, bool uppercase) noexcept {
+    const char* digits = uppercase ? UPPER_HEX_DIGITS : LOWER_HEX_DIGITS;
+
+    // 64 位整数中有效的半字节数，0 也需要输出一位。
+    size_t len = (64 - __builtin_clzll(val | 1) + 3) / 4;
+
+    char* pos = dst + len;
+    do {
+        *--pos = digits[val & 0xf];
+        val >>= 4;
+    } while (val != 0);
+    return len;
+}
+
+size_t FormatPointer(char* dst, const void* ptr) noexcept {
+    if (ptr == nullptr) {
+        memcpy(dst, "(nil)", 5);
+        return 5;
+    }
+    dst[0] = '0';
+    dst[1] = 'x';
+    return 2 + FormatHex(dst + 2, reinterpret_cast<uintptr_t>(ptr), false);
+}
+
+char* FormatFixedFloat(char* first, char* last, double val,
+                       int precision) noexcept {
+#if defined(__cpp_lib_to_chars)
+    // 标准规定带精度的 to_chars 与 C locale 下的 printf 输出相同。
+    // LC_NUMERIC 的小数点不是 '.' 时（如 de_DE），交给遵循 locale 的 snprintf。
+    const char* decimal_point = localeconv()->decimal_point;
+    if (decimal_point[0] == '.' && decimal_point[1] == '\0') {
+        std::to_chars_result result = std::to_chars(
+            first, last, val, std::chars_format::fixed, precision);
+        if (result.ec != std::errc())
+            return nullptr;
+        return result.ptr;
+    }
+#endif
+    size_t size = last - first;
+    int len = snprintf(first, size, "%.*f", precision, val);
+    if (len < 0 || static_cast<size_t>(len) >= size)
+        return nullptr;
+    return first + len;
+}
+
+}  // namespace fast_format
+}  // namespace olog
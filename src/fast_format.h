@@ -0,0 +1,82 @@
+#ifndef OLOG_FAST_FORMAT_H
+#define OLOG_FAST_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace olog {
+
+/**
+ * fast_format 命名空间下定义了常用格式描述符的转换函数。
+ * 它们的输出与 snprintf 完全相同，但不需要在运行时解析格式描述符。
+ * LogAssembler 只对没有 flag、width 等修饰的格式描述符使用这些函数，
+ * 其余情况仍然交给 snprintf。
+ */
+namespace fast_format {
+
+// 64 位整数的十进制表示（含负号）的最大长度。
+static constexpr size_t MAX_INTEGER_LENGTH = 20;
+
+// 指针的十六进制表示（含 "0x"）的最大长度。
+static constexpr size_t MAX_POINTER_LENGTH = 2 + sizeof(void*) * 2;
+
+/**
+ * @brief
+ * 与 "%lu" 相同，将无符号整数转换为十进制。
+ *
+ * @param dst 写入位置，至少需要 MAX_INTEGER_LENGTH 字节。
+ * @param val
+ * @return 写入的字节数，结尾不写入 '\0'。
+ */
+size_t FormatUnsignedDecimal(char* dst, uint64_t val) noexcept;
+
+/**
+ * @brief
+ * 与 "%ld" 相同，将有符号整数转换为十进制。
+ *
+ * @param dst 写入位置，至少需要 MAX_INTEGER_LENGTH 字节。
+ * @param val
+ * @return 写入的字节数，结尾不写入 '\0'。
+ */
+size_t FormatSignedDecimal(char* dst, int64_t val) noexcept;
+
+/**
+ * @brief
+ * 与 "%lx" 或 "%lX" 相同，将无符号整数转换为十六进制。
+ *
+ * @param dst 写入位置，至少需要 MAX_INTEGER_LENGTH 字节。
+ * @param val
+ * @param uppercase 是否使用大写字母。
+ * @return 写入的字节数，结尾不写入 '\0'。
+ */
+size_t FormatHex(char* dst, uint64_t val, bool uppercase) noexcept;
+
+/**
+ * @brief
+ * 与 glibc 的 "%p" 相同，空指针输出 "(nil)"，其余输出 "0x" 加十六进制地址。
+ *
+ * @param dst 写入位置，至少需要 MAX_POINTER_LENGTH 字节。
+ * @param ptr
+ * @return 写入的字节数，结尾不写入 '\0'。
+ */
+size_t FormatPointer(char* dst, const void* ptr) noexcept;
+
+/**
+ * @brief
+ * 与 "%.*f" 相同，以指定精度输出浮点数。val 必须是有限值。
+ * 与 snprintf 一样遵循 LC_NUMERIC 的小数点，只在小数点为 '.' 时
+ * 使用不依赖 locale 的快速转换。
+ *
+ * @param first 写入位置。
+ * @param last 可写入范围的结尾。
+ * @param val
+ * @param precision 小数点后的位数。
+ * @return 写入内容的结尾；空间不足时返回 nullptr。
+ */
+char* FormatFixedFloat(char* first, char* last, double val,
+                       int precision) noexcept;
+
+}  // namespace fast_format
+}  // namespace olog
+
+#endif
@@ -1,15 +1,72 @@
 #include "log_info.h"
 
+#include <cmath>
 #include <ctime>
+#include <limits>
+
+#include "fast_format.h"
 
 namespace olog {
 namespace log_info {
 
+namespace {
+
+/**
+ * @brief
+ * 按格式描述符所指定的整数类型读出一个实参，并扩展为 64 位。
+ * 有符号类型进行符号扩展，无符号类型进行零扩展，
+ * 与 printf 对实参进行的转换相同。
+ *
+ * @param conversion_type 格式描述符所指定的类型。
+ * @param read_pos 读位置。
+ * @param nbytes 实参所占大小。
+ * @return int64_t 需要按无符号数输出时由调用者转换为 uint64_t。
+ */
+inline int64_t LoadInteger(ConversionType conversion_type,
+                           const char* read_pos, size_t nbytes) {
+    switch (conversion_type) {
+    case ConversionType::unsigned_char_t:
+        return LoadArgument<unsigned char>(read_pos, nbytes);
+    case ConversionType::unsigned_short_int_t:
+        return LoadArgument<unsigned short int>(read_pos, nbytes);
+    case ConversionType::unsigned_int_t:
+        return LoadArgument<unsigned int>(read_pos, nbytes);
+    case ConversionType::unsigned_long_int_t:
+        return LoadArgument<unsigned long int>(read_pos, nbytes);
+    case ConversionType::unsigned_long_long_int_t:
+        return LoadArgument<unsigned long long int>(read_pos, nbytes);
+    case ConversionType::uintmax_t_t:
+        return LoadArgument<uintmax_t>(read_pos, nbytes);
+    case ConversionType::size_t_t:
+        return LoadArgument<size_t>(read_pos, nbytes);
+    case ConversionType::signed_char_t:
+        return LoadArgument<signed char>(read_pos, nbytes);
+    case ConversionType::short_int_t:
+        return LoadArgument<short int>(read_pos, nbytes);
+    case ConversionType::int_t:
+        return LoadArgument<int>(read_pos, nbytes);
+    case ConversionType::long_int_t:
+        return LoadArgument<long int>(read_pos, nbytes);
+    case ConversionType::long_long_int_t:
+        return LoadArgument<long long int>(read_pos, nbytes);
+    case ConversionType::intmax_t_t:
+        return LoadArgument<intmax_t>(read_pos, nbytes);
+    case ConversionType::ptrdiff_t_t:
+        return LoadArgument<ptrdiff_t>(read_pos, nbytes);
+    default:
+        return 0;
+    }
+}
+
+}  // namespace
+
 bool operator==(const FormatFragment& f1, const FormatFragment& f2) {
     return f1.conversion_type_ == f2.conversion_type_ &&
            f1.specifier_length_ == f2.specifier_length_ &&
            f1.format_pos_ == f2.format_pos_ &&
-           f1.storage_pos_ == f2.storage_pos_;
+           f1.storage_pos_ == f2.storage_pos_ &&
+           f1.fast_format_ == f2.fast_format_ &&
+           f1.precision_ == f2.precision_;
 }
 
 LogAssembler::LogAssembler()
@@ -21,31 +78,48 @@ LogAssembler::LogAssembler()
       static_log_info_(nullptr),
       dynamic_log_info_(nullptr),
       timestamp_str_(),
-      filename_and_linenum_(),
-      producer_id_("[0]: "),
+      timestamp_len_(0),
+      tsc_calibration_(),
+      timestamp_precision_(TimestampPrecision::MILLISECOND),
+      cached_timestamp_second_(std::numeric_limits<int64_t>::min()),
+      static_prefix_(),
+      producer_prefix_(),
+      owned_static_prefix_(),
+      owned_producer_prefix_(),
       end_of_log_("\r\n"),
       is_full_(false) {}
 
+std::string MakeStaticPrefix(const StaticLogInfo& static_info) {
+    static const char* severity_str[] = {"[<none>]", "[ERROR]", "[WARNING]",
+                                         "[INFO]", "[DEBUG]"};
+
+    std::string prefix(static_info.filename_);
+    prefix.push_back(':');
+    prefix.append(std::to_string(static_info.line_number_));
+    prefix.push_back(' ');
+    prefix.append(severity_str[static_cast<size_t>(static_info.log_level_)]);
+    return prefix;
+}
+
+std::string MakeProducerPrefix(size_t producer_id) {
+    std::string prefix("[");
+    prefix.append(std::to_string(producer_id));
+    prefix.append("]: ");
+    return prefix;
+}
+
 const StaticLogInfo* LogAssembler::loadStaticInfo(
-    const StaticLogInfo* static_info) {
+    const StaticLogInfo* static_info, std::string_view static_prefix) {
     const StaticLogInfo* pre = static_log_info_;
     static_log_info_ = static_info;
-
-    if (static_log_info_ != nullptr) {
-        filename_and_linenum_.clear();
-        filename_and_linenum_.append(std::string_view(static_info->filename_));
-        filename_and_linenum_.push_back(':');
-        filename_and_linenum_.append(
-            std::to_string(static_log_info_->line_number_));
-        filename_and_linenum_.push_back(' ');
+    static_prefix_ = static_prefix;
 
 #ifdef OLOG_ENABLE_LOG_INFO_DEBUG_PRINTTING
-        printf(
-            "LogAssembler loaded static log info:\n"
-            "  filename and linenum: %s\n",
-            filename_and_linenum_.c_str());
+    printf(
+        "LogAssembler loaded static log info:\n"
+        "  prefix: %.*s\n",
+        static_cast<int>(static_prefix_.size()), static_prefix_.data());
 #endif
-    }
 
     resetIndices();
     resetFlags();
@@ -58,21 +132,45 @@ const DynamicLogInfo* LogAssembler::loadDynamicInfo(
     dynamic_log_info_ = dynamic_info;
 
     if (dynamic_log_info_ != nullptr) {
-        time_t timestamp_seconds = dynamic_log_info_->ms_timestamp_ / 1000;
-        int64_t timestamp_milisecond = dynamic_log_info_->ms_timestamp_ % 1000;
-        size_t index =
+        int64_t timestamp_ns =
+            tsc_calibration_.toNs(dynamic_log_info_->timestamp_);
+        int64_t timestamp_second = timestamp_ns / 1000000000;
+        int64_t timestamp_subsecond = timestamp_ns % 1000000000;
+
+        // 相邻的日志大多处于同一秒内，只在秒数变化时重新进行时区转换。
+        if (timestamp_second != cached_timestamp_second_) {
+            time_t seconds = static_cast<time_t>(timestamp_second);
+            struct tm local_time;
+            localtime_r(&seconds, &local_time);
             strftime(timestamp_str_.data(), timestamp_str_.size(),
-                     "%Y-%m-%d %H:%M:%S.", localtime(&timestamp_seconds));
-        timestamp_str_[index++] = '0' + (timestamp_milisecond / 100);
-        timestamp_str_[index++] = '0' + ((timestamp_milisecond % 100) / 10);
-        timestamp_str_[index++] = '0' + (timestamp_milisecond % 10);
+                     "%Y-%m-%d %H:%M:%S.", &local_time);
+            cached_timestamp_second_ = timestamp_second;
+        }
+
+        // 按精度舍去多余的位数。
+        size_t num_digits = 9;
+        if (timestamp_precision_ == TimestampPrecision::MILLISECOND) {
+            num_digits = 3;
+            timestamp_subsecond /= 1000000;
+        } else if (timestamp_precision_ == TimestampPrecision::MICROSECOND) {
+            num_digits = 6;
+            timestamp_subsecond /= 1000;
+        }
+
+        size_t index = std::size("YYYY-MM-DD hh:mm:ss.") - 1;
+        for (size_t i = num_digits; i > 0; --i) {
+            timestamp_str_[index + i - 1] = '0' + timestamp_subsecond % 10;
+            timestamp_subsecond /= 10;
+        }
+        index += num_digits;
         timestamp_str_[index++] = ' ';
+        timestamp_len_ = index;
 
 #ifdef OLOG_ENABLE_LOG_INFO_DEBUG_PRINTTING
         printf(
             "LogAssembler loaded dynamic log info:\n"
-            "  timestamp: %s\n",
-            timestamp_str_.data());
+            "  timestamp: %.*s\n",
+            static_cast<int>(timestamp_len_), timestamp_str_.data());
 #endif
 
         args_read_pos_ = dynamic_log_info_->arg_data;
@@ -83,18 +181,13 @@ const DynamicLogInfo* LogAssembler::loadDynamicInfo(
     return pre;
 }
 
-void LogAssembler::setProducerId(size_t id) {
-    producer_id_.clear();
-    producer_id_.push_back('[');
-    producer_id_.append(std::to_string(id));
-    producer_id_.append("]: ");
-
-#ifdef OLOG_ENABLE_LOG_INFO_DEBUG_PRINTTING
-    printf(
-        "LogAssembler changed producer id:\n"
-        "  producer id: %s\n",
-        producer_id_.c_str());
-#endif
+void LogAssembler::loadLogInfo(const StaticLogInfo* static_info,
+                               const DynamicLogInfo* dynamic_info,
+                               size_t producer_id) {
+    owned_static_prefix_ = MakeStaticPrefix(*static_info);
+    owned_producer_prefix_ = MakeProducerPrefix(producer_id);
+    loadLogInfo(static_info, dynamic_info, owned_static_prefix_,
+                owned_producer_prefix_);
 }
 
 size_t LogAssembler::write() noexcept {
@@ -105,8 +198,8 @@ size_t LogAssembler::write() noexcept {
 
     // 写入时间戳。
     if (!is_timestamp_writed_) {
-        size_t tmp = tryToWriteAStringToBuffer(timestamp_str_.data(),
-                                               timestamp_str_.size() - 1);
+        size_t tmp =
+            tryToWriteAStringToBuffer(timestamp_str_.data(), timestamp_len_);
         if (tmp == 0)
             return bytes_last_writed_;
         finishWriting(tmp);
@@ -114,40 +207,21 @@ size_t LogAssembler::write() noexcept {
         is_timestamp_writed_ = true;
     }
 
-    // 写入文件名和行号。
-    if (!is_filename_and_linenum_writed_) {
-        size_t tmp = tryToWriteAStringToBuffer(filename_and_linenum_.c_str(),
-                                               filename_and_linenum_.size());
-        if (tmp == 0)
-            return bytes_last_writed_;
-        finishWriting(tmp);
-
-        is_filename_and_linenum_writed_ = true;
-    }
-
-    // 写入日志等级。
-    if (!is_severity_writed_) {
-        static const char* severity_str[] = {"[<none>]", "[ERROR]", "[WARNING]",
-                                             "[INFO]", "[DEBUG]"};
-        static const size_t severity_str_len[] = {
-            std::size("[<none>]") - 1, std::size("[ERROR]") - 1,
-            std::size("[WARNING]") - 1, std::size("[INFO]") - 1,
-            std::size("[DEBUG]") - 1};
-
-        size_t index = static_cast<size_t>(static_log_info_->log_level_);
-        size_t tmp = tryToWriteAStringToBuffer(severity_str[index],
-                                               severity_str_len[index]);
+    // 写入文件名、行号和日志等级。
+    if (!is_static_prefix_writed_) {
+        size_t tmp = tryToWriteAStringToBuffer(static_prefix_.data(),
+                                               static_prefix_.size());
         if (tmp == 0)
             return bytes_last_writed_;
         finishWriting(tmp);
 
-        is_severity_writed_ = true;
+        is_static_prefix_writed_ = true;
     }
 
     // 写入生产者编号。
     if (!is_producer_id_writed_) {
-        size_t tmp = tryToWriteAStringToBuffer(producer_id_.c_str(),
-                                               producer_id_.size());
+        size_t tmp = tryToWriteAStringToBuffer(producer_prefix_.data(),
+                                               producer_prefix_.size());
         if (tmp == 0)
             return bytes_last_writed_;
         finishWriting(tmp);
@@ -221,129 +295,14 @@ size_t LogAssembler::write() noexcept {
                     parameter_index_++;
                 }
 
-                /**
-                 * TODO: write args.
-                 */
-                const char* conversion_fmt =
-                    static_log_info_->conversion_storage_ +
-                    fragment->storage_pos_;
                 size_t arg_size =
                     static_log_info_->param_sizes_[parameter_index_];
 
-                size_t tmp = 0;
-                switch (fragment->conversion_type_) {
-                case ConversionType::unsigned_char_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<unsigned char>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::unsigned_short_int_t:
-                    tmp =
-                        tryToWriteArgToBuffer(conversion_fmt, width, precision,
-                                              LoadArgument<unsigned short int>(
-                                                  args_read_pos_, arg_size));
-                    break;
-                case ConversionType::unsigned_int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<unsigned int>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::unsigned_long_int_t:
-                    tmp =
-                        tryToWriteArgToBuffer(conversion_fmt, width, precision,
-                                              LoadArgument<unsigned long int>(
-                                                  args_read_pos_, arg_size));
-                    break;
-                case ConversionType::unsigned_long_long_int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<unsigned long long int>(args_read_pos_,
-                                                             arg_size));
-                    break;
-                case ConversionType::uintmax_t_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<uintmax_t>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::size_t_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<size_t>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::wint_t_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<wint_t>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::signed_char_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<signed char>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::short_int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<short int>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<int>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::long_int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<long int>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::long_long_int_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<long long int>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::intmax_t_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<intmax_t>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::ptrdiff_t_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<ptrdiff_t>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::double_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<double>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::long_double_t:
-                    tmp = tryToWriteArgToBuffer(
-                        conversion_fmt, width, precision,
-                        LoadArgument<long double>(args_read_pos_, arg_size));
-                    break;
-                case ConversionType::const_void_ptr_t:
-                    tmp = tryToWriteArgToBuffer<const void*>(
-                        conversion_fmt, width, precision, args_read_pos_);
-                    break;
-                case ConversionType::const_char_ptr_t:
-                    arg_size =
-                        LoadArgument<size_t>(args_read_pos_, sizeof(size_t));
-                    args_read_pos_ += sizeof(size_t);
-                    tmp = tryToWriteArgToBuffer<const char*>(
-                        conversion_fmt, width, precision, args_read_pos_);
-                    args_read_pos_ += arg_size + 1;
-                    break;
-                case ConversionType::const_wchar_t_ptr_t:
-                    arg_size =
-                        LoadArgument<size_t>(args_read_pos_, sizeof(size_t));
-                    args_read_pos_ += sizeof(size_t);
-                    tmp = tryToWriteArgToBuffer<const wchar_t*>(
-                        conversion_fmt, width, precision,
-                        LoadArgument<const wchar_t*>(args_read_pos_, 0));
-                    args_read_pos_ += arg_size + 1;
-                    break;
-                default:
-                    break;
-                }
+                size_t tmp =
+                    fragment->fast_format_ != FastFormat::NONE
+                        ? tryToWriteArgFast(fragment, arg_size)
+                        : tryToWriteArgWithSnprintf(fragment, width, precision,
+                                                    arg_size);
 
                 if (tmp == 0 && arg_size > 0) {
                     conversion_index_ = original_conversion_index;
@@ -386,5 +345,185 @@ size_t LogAssembler::write() noexcept {
     return bytes_last_writed_;
 }
 
+size_t LogAssembler::tryToWriteArgFast(const FormatFragment* fragment,
+                                       size_t& arg_size) noexcept {
+    // 整数和指针先写入临时数组，剩余空间充足时直接写入缓冲区。
+    char scratch[fast_format::MAX_INTEGER_LENGTH + 1];
+    char* dst = getFreeBytes() > sizeof(scratch) ? write_pos_ : scratch;
+    size_t len = 0;
+
+    switch (fragment->fast_format_) {
+    case FastFormat::SIGNED_DECIMAL:
+        len = fast_format::FormatSignedDecimal(
+            dst, LoadInteger(fragment->conversion_type_, args_read_pos_,
+                             arg_size));
+        break;
+
+    case FastFormat::UNSIGNED_DECIMAL:
+        len = fast_format::FormatUnsignedDecimal(
+            dst, static_cast<uint64_t>(LoadInteger(
+                     fragment->conversion_type_, args_read_pos_, arg_size)));
+        break;
+
+    case FastFormat::LOWER_HEX:
+    case FastFormat::UPPER_HEX:
+        len = fast_format::FormatHex(
+            dst,
+            static_cast<uint64_t>(LoadInteger(fragment->conversion_type_,
+                                              args_read_pos_, arg_size)),
+            fragment->fast_format_ == FastFormat::UPPER_HEX);
+        break;
+
+    case FastFormat::POINTER: {
+        const void* ptr = nullptr;
+        memcpy(&ptr, args_read_pos_, sizeof(ptr));
+        len = fast_format::FormatPointer(dst, ptr);
+        break;
+    }
+
+    case FastFormat::STRING: {
+        // 字符串在存储时已经按精度截断，直接复制即可。
+        arg_size = LoadArgument<size_t>(args_read_pos_, sizeof(size_t));
+        args_read_pos_ += sizeof(size_t);
+        size_t tmp = tryToWriteAStringToBuffer(args_read_pos_, arg_size);
+        args_read_pos_ += arg_size + 1;
+        return tmp;
+    }
+
+    case FastFormat::FIXED_FLOAT: {
+        double val = LoadArgument<double>(args_read_pos_, arg_size);
+
+        // inf 和 nan 的输出与平台相关，交给 snprintf。
+        if (!std::isfinite(val))
+            return tryToWriteArgWithSnprintf(fragment, -1, -1, arg_size);
+
+        // 与 snprintf 相同，至少为结尾的 '\0' 保留一个字节。
+        if (getFreeBytes() == 0) {
+            is_full_ = true;
+            return 0;
+        }
+        char* end = fast_format::FormatFixedFloat(
+            write_pos_, write_pos_ + getFreeBytes() - 1, val,
+            fragment->precision_ == -1 ? 6 : fragment->precision_);
+        if (end == nullptr) {
+            is_full_ = true;
+            return 0;
+        }
+        return end - write_pos_;
+    }
+
+    default:
+        return tryToWriteArgWithSnprintf(fragment, -1, -1, arg_size);
+    }
+
+    if (dst == scratch)
+        return tryToWriteAStringToBuffer(scratch, len);
+    return len;
+}
+
+size_t LogAssembler::tryToWriteArgWithSnprintf(const FormatFragment* fragment,
+                                               int width, int precision,
+                                               size_t& arg_size) {
+    const char* conversion_fmt =
+        static_log_info_->conversion_storage_ + fragment->storage_pos_;
+
+    switch (fragment->conversion_type_) {
+    case ConversionType::unsigned_char_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<unsigned char>(args_read_pos_, arg_size));
+    case ConversionType::unsigned_short_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<unsigned short int>(args_read_pos_, arg_size));
+    case ConversionType::unsigned_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<unsigned int>(args_read_pos_, arg_size));
+    case ConversionType::unsigned_long_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<unsigned long int>(args_read_pos_, arg_size));
+    case ConversionType::unsigned_long_long_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<unsigned long long int>(args_read_pos_, arg_size));
+    case ConversionType::uintmax_t_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<uintmax_t>(args_read_pos_, arg_size));
+    case ConversionType::size_t_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<size_t>(args_read_pos_, arg_size));
+    case ConversionType::wint_t_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<wint_t>(args_read_pos_, arg_size));
+    case ConversionType::signed_char_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<signed char>(args_read_pos_, arg_size));
+    case ConversionType::short_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<short int>(args_read_pos_, arg_size));
+    case ConversionType::int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<int>(args_read_pos_, arg_size));
+    case ConversionType::long_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<long int>(args_read_pos_, arg_size));
+    case ConversionType::long_long_int_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<long long int>(args_read_pos_, arg_size));
+    case ConversionType::intmax_t_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<intmax_t>(args_read_pos_, arg_size));
+    case ConversionType::ptrdiff_t_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<ptrdiff_t>(args_read_pos_, arg_size));
+    case ConversionType::double_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<double>(args_read_pos_, arg_size));
+    case ConversionType::long_double_t:
+        return tryToWriteArgToBuffer(
+            conversion_fmt, width, precision,
+            LoadArgument<long double>(args_read_pos_, arg_size));
+    case ConversionType::const_void_ptr_t: {
+        // 实参存储的是指针的值本身。
+        const void* ptr = nullptr;
+        memcpy(&ptr, args_read_pos_, sizeof(ptr));
+        return tryToWriteArgToBuffer(conversion_fmt, width, precision, ptr);
+    }
+    case ConversionType::const_char_ptr_t: {
+        arg_size = LoadArgument<size_t>(args_read_pos_, sizeof(size_t));
+        args_read_pos_ += sizeof(size_t);
+        size_t tmp = tryToWriteArgToBuffer<const char*>(
+            conversion_fmt, width, precision, args_read_pos_);
+        args_read_pos_ += arg_size + 1;
+        return tmp;
+    }
+    case ConversionType::const_wchar_t_ptr_t: {
+        arg_size = LoadArgument<size_t>(args_read_pos_, sizeof(size_t));
+        args_read_pos_ += sizeof(size_t);
+        size_t tmp = tryToWriteArgToBuffer<const wchar_t*>(
+            conversion_fmt, width, precision,
+            LoadArgument<const wchar_t*>(args_read_pos_, 0));
+        args_read_pos_ += arg_size + 1;
+        return tmp;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
 }  // namespace log_info
 }  // namespace olog
@@ -6,8 +6,12 @@
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <utility>
 
+#include "utils.h"
+
 namespace olog {
 
 /**
@@ -19,6 +23,9 @@ namespace log_info {
 // 未注册的 log_id 的默认值。
 static constexpr int UNREGISTERED_LOG_ID = -1;
 
+// 正在注册的 log_id，由赢得注册的线程在分配 id 之前占用。
+static constexpr int RESERVED_LOG_ID = -2;
+
 enum class LogLevel : uint8_t {
     NONE = 0,
     ERROR,
@@ -28,6 +35,20 @@ enum class LogLevel : uint8_t {
     NUMBER_OF_LOG_LEVELS  // 日志级别的数量。
 };
 
+/**
+ * @brief 文本日志中时间戳秒以下部分的精度。
+ */
+enum class TimestampPrecision : uint8_t {
+    // "hh:mm:ss.mmm"
+    MILLISECOND,
+
+    // "hh:mm:ss.uuuuuu"
+    MICROSECOND,
+
+    // "hh:mm:ss.nnnnnnnnn"
+    NANOSECOND
+};
+
 enum class ParamType : int32_t {
     // 非法类型。
     INVALID = -6,
@@ -85,6 +106,38 @@ enum class ConversionType : uint8_t {
     MAX_CONVERSION_TYPE
 };
 
+/**
+ * @brief
+ * 格式描述符可以使用的快速转换方式。
+ * 对于没有 flag、width 等修饰的常用格式描述符，LogAssembler 使用
+ * fast_format 中的转换函数代替 snprintf，输出与 snprintf 完全相同。
+ */
+enum class FastFormat : uint8_t {
+    // 只能使用 snprintf。
+    NONE,
+
+    // "%d"、"%i" 及其带 length 的形式。
+    SIGNED_DECIMAL,
+
+    // "%u" 及其带 length 的形式。
+    UNSIGNED_DECIMAL,
+
+    // "%x" 及其带 length 的形式。
+    LOWER_HEX,
+
+    // "%X" 及其带 length 的形式。
+    UPPER_HEX,
+
+    // "%s"、"%.20s"、"%.*s"。字符串在存储时已经按精度截断。
+    STRING,
+
+    // "%p"。
+    POINTER,
+
+    // "%f"、"%.2f"、"%lf"。
+    FIXED_FLOAT
+};
+
 /**
  * @brief
  * 格式描述符片段。
@@ -105,6 +158,12 @@ struct FormatFragment {
     // 在格式描述符尾部添加了 '\0' 后的存储数组中的起始位置。
     const size_t storage_pos_;
 
+    // 可以使用的快速转换方式。
+    const FastFormat fast_format_;
+
+    // 格式描述符中写明的精度，没有精度或精度为 '*' 时为 -1。
+    const int precision_;
+
     friend bool operator==(const FormatFragment&, const FormatFragment&);
 };
 
@@ -121,14 +180,13 @@ struct FormatFragment {
 bool operator==(const FormatFragment& f1, const FormatFragment& f2);
 
 struct StaticLogInfo {
-    explicit StaticLogInfo(const char* filename, const uint32_t line_number,
-                           const LogLevel log_level, const size_t format_len,
-                           const size_t num_conversions,
-                           const size_t num_parameters, const char* format_str,
-                           const char* conversion_storage,
-                           const FormatFragment* format_fragments,
-                           const ParamType* param_types,
-                           const size_t* param_sizes)
+    constexpr explicit StaticLogInfo(
+        const char* filename, const uint32_t line_number,
+        const LogLevel log_level, const size_t format_len,
+        const size_t num_conversions, const size_t num_parameters,
+        const char* format_str, const char* conversion_storage,
+        const FormatFragment* format_fragments, const ParamType* param_types,
+        const size_t* param_sizes)
         : filename_(filename),
           line_number_(line_number),
           log_level_(log_level),
@@ -182,13 +240,32 @@ struct DynamicLogInfo {
     // 包含 arg_data 在内的整个结构体的大小。
     size_t info_size_;
 
-    // 单位为毫秒的时间戳。
-    int64_t ms_timestamp_;
+    // 生产者读取的时间戳计数器的值，由 utils::TscCalibration 转换为时间。
+    uint64_t timestamp_;
 
     // 使用柔性数组传递格式串的实参信息。
     char arg_data[];
 };
 
+/**
+ * @brief
+ * 生成一条日志静态信息在文本日志中的前缀，包括文件名、行号和日志等级。
+ * 例如 "main.cc:42 [INFO]"。
+ *
+ * @param static_info
+ * @return std::string
+ */
+std::string MakeStaticPrefix(const StaticLogInfo& static_info);
+
+/**
+ * @brief
+ * 生成生产者编号在文本日志中的前缀。例如 "[3]: "。
+ *
+ * @param producer_id
+ * @return std::string
+ */
+std::string MakeProducerPrefix(size_t producer_id);
+
 /**
  * @brief
  * LogAssembler 的职责是通过静态信息和动态信息将日志恢复并写入到指定位置。
@@ -214,16 +291,40 @@ class LogAssembler {
         is_full_ = false;
     }
 
+    /**
+     * @brief 装载一条日志。
+     *
+     * @param static_info
+     * @param dynamic_info
+     * @param static_prefix 由 MakeStaticPrefix 生成的前缀。
+     * @param producer_prefix 由 MakeProducerPrefix 生成的前缀。
+     *
+     * @note
+     * 两个前缀只被引用而不会被复制，在日志被完全写出之前必须保持有效。
+     */
     inline void loadLogInfo(const StaticLogInfo* static_info,
                             const DynamicLogInfo* dynamic_info,
-                            size_t producer_id) {
-        loadStaticInfo(static_info);
+                            std::string_view static_prefix,
+                            std::string_view producer_prefix) {
+        loadStaticInfo(static_info, static_prefix);
         loadDynamicInfo(dynamic_info);
-        setProducerId(producer_id);
+        producer_prefix_ = producer_prefix;
         resetIndices();
         resetFlags();
     }
 
+    /**
+     * @brief
+     * 装载一条日志，并为它生成前缀。
+     * 每次调用都会构造前缀字符串，只适合在不关心性能的场合使用。
+     *
+     * @param static_info
+     * @param dynamic_info
+     * @param producer_id 日志来自的生产者的编号。
+     */
+    void loadLogInfo(const StaticLogInfo* static_info,
+                     const DynamicLogInfo* dynamic_info, size_t producer_id);
+
     /**
      * @brief 进行一次写入操作。
      *
@@ -245,15 +346,32 @@ class LogAssembler {
 
     inline bool isBufferFull() const { return is_full_; }
 
+    /**
+     * @brief 设置将时间戳计数器转换为时间所使用的校准。
+     * 对之后装载的日志生效。
+     */
+    inline void setTscCalibration(const utils::TscCalibration& calibration) {
+        tsc_calibration_ = calibration;
+    }
+
+    /**
+     * @brief 设置时间戳的精度。对之后装载的日志生效。
+     */
+    inline void setTimestampPrecision(TimestampPrecision precision) {
+        timestamp_precision_ = precision;
+    }
+
   private:
     /**
      * @brief 装载日志静态信息。
      *
      * @param static_info
+     * @param static_prefix 静态信息对应的前缀。
      *
      * @return 前一个被装载的日志静态信息。
      */
-    const StaticLogInfo* loadStaticInfo(const StaticLogInfo* static_info);
+    const StaticLogInfo* loadStaticInfo(const StaticLogInfo* static_info,
+                                        std::string_view static_prefix);
 
     /**
      * @brief 装载日志动态信息。
@@ -264,13 +382,6 @@ class LogAssembler {
      */
     const DynamicLogInfo* loadDynamicInfo(const DynamicLogInfo* dynamic_info);
 
-    /**
-     * @brief 设置日志来自的生产者的编号。默认为 0。
-     *
-     * @param id
-     */
-    void setProducerId(size_t id);
-
     inline void resetIndices() {
         conversion_index_ = 0;
         parameter_index_ = 0;
@@ -278,9 +389,8 @@ class LogAssembler {
     }
 
     inline void resetFlags() {
-        is_timestamp_writed_ = is_filename_and_linenum_writed_ =
-            is_severity_writed_ = is_producer_id_writed_ =
-                is_end_of_log_writed_ = false;
+        is_timestamp_writed_ = is_static_prefix_writed_ =
+            is_producer_id_writed_ = is_end_of_log_writed_ = false;
     }
 
     inline void finishWriting(size_t bytes_writed) {
@@ -334,6 +444,32 @@ class LogAssembler {
         return bytes_writed;
     }
 
+    /**
+     * @brief
+     * 使用 fast_format 中的转换函数写入一个实参，不经过 printf 的格式解析。
+     * 仅用于 fast_format_ 不为 FastFormat::NONE 的格式描述符。
+     *
+     * @param fragment 格式描述符片段。
+     * @param arg_size 实参所占大小，对字符串会被更新为字符串的长度。
+     * @return 写入的字节数。写入失败时返回 0，同时设置 is_full_。
+     */
+    size_t tryToWriteArgFast(const FormatFragment* fragment,
+                             size_t& arg_size) noexcept;
+
+    /**
+     * @brief
+     * 使用 snprintf 和存储的格式描述符写入一个实参。
+     *
+     * @param fragment 格式描述符片段。
+     * @param width 动态宽度，没有时为 -1。
+     * @param precision 动态精度，没有时为 -1。
+     * @param arg_size 实参所占大小，对字符串会被更新为字符串的长度。
+     * @return 写入的字节数。写入失败时返回 0，同时设置 is_full_。
+     */
+    size_t tryToWriteArgWithSnprintf(const FormatFragment* fragment,
+                                     int width, int precision,
+                                     size_t& arg_size);
+
   private:
     char* write_pos_;
     size_t buffer_size_;
@@ -352,14 +488,29 @@ class LogAssembler {
     const char* args_read_pos_;
 
     // 时间戳字符串，尾部有一个空格。
-    std::array<char, std::size("YYYY-MM-DD hh:mm:ss.mil ")> timestamp_str_;
+    std::array<char, std::size("YYYY-MM-DD hh:mm:ss.nnnnnnnnn ")>
+        timestamp_str_;
 
-    // 文件名与行号，中间以 ':' 分隔，尾部有一个空格。
-    // "filename:linenum "
-    std::string filename_and_linenum_;
+    // timestamp_str_ 中有效内容的长度。
+    size_t timestamp_len_;
+
+    utils::TscCalibration tsc_calibration_;
+
+    TimestampPrecision timestamp_precision_;
+
+    // timestamp_str_ 中日期和时间部分所对应的秒数。
+    int64_t cached_timestamp_second_;
+
+    // 文件名、行号与日志等级。
+    // "filename:linenum [LEVEL]"
+    std::string_view static_prefix_;
 
     // 日志来自的生产者编号，被方括号包裹，尾部跟有 ": "。
-    std::string producer_id_;
+    std::string_view producer_prefix_;
+
+    // 由 LogAssembler 自行生成前缀时，用于存放前缀。
+    std::string owned_static_prefix_;
+    std::string owned_producer_prefix_;
 
     std::string_view end_of_log_;
 
@@ -370,8 +521,7 @@ class LogAssembler {
     // 被中断后，再次调用 write() 方法可以恢复现场。
 
     bool is_timestamp_writed_;
-    bool is_filename_and_linenum_writed_;
-    bool is_severity_writed_;
+    bool is_static_prefix_writed_;
     bool is_producer_id_writed_;
     bool is_end_of_log_writed_;
 };
@@ -738,6 +888,210 @@ constexpr inline ConversionType GetConversionType(
     return ConversionType::NONE;
 }
 
+/**
+ * @brief 解析目标格式串中指定位置的格式指示符可以使用的快速转换方式。
+ *
+ * @tparam _FormatLength
+ * 格式串长度，该参数会被自动推导。
+ *
+ * @param conversion_num
+ * 被解析的格式指示符位置。
+ *
+ * @return constexpr FastFormat
+ *
+ * @throw std::invalid_argument
+ * 对参数解析错误。
+ */
+template <size_t _FormatLength>
+constexpr inline FastFormat GetFastFormat(const char (&fmt)[_FormatLength],
+                                          size_t conversion_num = 0) {
+    size_t index = 0;
+    while (index < _FormatLength) {
+        if (fmt[index] != '%') {
+            ++index;
+            continue;
+        }
+        ++index;
+
+        // 连续两个 '%'，转义。
+        if (fmt[index] == '%') {
+            ++index;
+            continue;
+        }
+
+        // 处理 flag。
+        bool has_flag_or_width = false;
+        while (IsFlag(fmt[index])) {
+            has_flag_or_width = true;
+            ++index;
+        }
+
+        // 处理 width。
+        if (fmt[index] == '*') {
+            has_flag_or_width = true;
+            ++index;
+        } else {
+            while (IsDigit(fmt[index])) {
+                has_flag_or_width = true;
+                ++index;
+            }
+        }
+
+        // 处理 precision。
+        bool has_precision = false;
+        bool has_dynamic_precision = false;
+        if (fmt[index] == '.') {
+            has_precision = true;
+            ++index;
+            if (fmt[index] == '*') {
+                has_dynamic_precision = true;
+                ++index;
+            } else {
+                while (IsDigit(fmt[index])) {
+                    ++index;
+                }
+            }
+        }
+
+        // 处理 length。
+        bool has_length = false;
+        bool L_flag = false;  // length 中是否包含 'L'。
+        bool l_flag = false;  // length 中是否包含 'l'。
+        while (IsLength(fmt[index])) {
+            has_length = true;
+            if (fmt[index] == 'L')
+                L_flag = true;
+            else if (fmt[index] == 'l')
+                l_flag = true;
+            ++index;
+        }
+
+        if (!IsConversionSpecifier(fmt[index]))
+            throw std::invalid_argument(
+                "Unrecognized conversion specifier after %");
+
+        if (fmt[index] == 'n')
+            throw std::invalid_argument(
+                "Conversion specifier %n is not supported by OLog.");
+
+        // 非目标 conversion，略过。
+        if (conversion_num > 0) {
+            --conversion_num;
+            ++index;
+            continue;
+        }
+
+        if (has_flag_or_width)
+            return FastFormat::NONE;
+
+        switch (fmt[index]) {
+        case 'd':
+        case 'i':
+            return has_precision ? FastFormat::NONE
+                                 : FastFormat::SIGNED_DECIMAL;
+        case 'u':
+            return has_precision ? FastFormat::NONE
+                                 : FastFormat::UNSIGNED_DECIMAL;
+        case 'x':
+            return has_precision ? FastFormat::NONE : FastFormat::LOWER_HEX;
+        case 'X':
+            return has_precision ? FastFormat::NONE : FastFormat::UPPER_HEX;
+        case 's':
+            return l_flag ? FastFormat::NONE : FastFormat::STRING;
+        case 'p':
+            return has_precision || has_length ? FastFormat::NONE
+                                               : FastFormat::POINTER;
+        case 'f':
+            return has_dynamic_precision || L_flag ? FastFormat::NONE
+                                                   : FastFormat::FIXED_FLOAT;
+        default:
+            return FastFormat::NONE;
+        }
+    }
+    return FastFormat::NONE;
+}
+
+/**
+ * @brief 获取目标格式串中指定位置的格式指示符中写明的精度。
+ *
+ * @tparam _FormatLength
+ * 格式串长度，该参数会被自动推导。
+ *
+ * @param conversion_num
+ * 被解析的格式指示符位置。
+ *
+ * @return 精度值。没有精度或精度为 '*' 时返回 -1，只有 '.' 时返回 0。
+ *
+ * @throw std::invalid_argument
+ * 对参数解析错误。
+ */
+template <size_t _FormatLength>
+constexpr inline int GetStaticPrecision(const char (&fmt)[_FormatLength],
+                                        size_t conversion_num = 0) {
+    size_t index = 0;
+    while (index < _FormatLength) {
+        if (fmt[index] != '%') {
+            ++index;
+            continue;
+        }
+        ++index;
+
+        // 连续两个 '%'，转义。
+        if (fmt[index] == '%') {
+            ++index;
+            continue;
+        }
+
+        // 处理 flag。
+        while (IsFlag(fmt[index])) {
+            ++index;
+        }
+
+        // 处理 width。
+        if (fmt[index] == '*') {
+            ++index;
+        } else {
+            while (IsDigit(fmt[index])) {
+                ++index;
+            }
+        }
+
+        // 处理 precision。
+        int precision = -1;
+        if (fmt[index] == '.') {
+            ++index;
+            if (fmt[index] == '*') {
+                ++index;
+            } else {
+                precision = 0;
+                while (IsDigit(fmt[index])) {
+                    precision = precision * 10 + (fmt[index] - '0');
+                    ++index;
+                }
+            }
+        }
+
+        // 处理 length。
+        while (IsLength(fmt[index])) {
+            ++index;
+        }
+
+        if (!IsConversionSpecifier(fmt[index]))
+            throw std::invalid_argument(
+                "Unrecognized conversion specifier after %");
+
+        if (fmt[index] == 'n')
+            throw std::invalid_argument(
+                "Conversion specifier %n is not supported by OLog.");
+
+        if (conversion_num == 0)
+            return precision;
+        --conversion_num;
+        ++index;
+    }
+    return -1;
+}
+
 /**
  * @brief 获取格式串中格式指示符的总数。
  *
@@ -1205,7 +1559,8 @@ GetFormatFragmentsHelper(const char (&fmt)[_FormatLength],
         GetConversionType(fmt, _Indices),
         GetConversionSpecifierLength(storage, _Indices),
         GetConversionSpecifierPosition(fmt, _Indices),
-        GetConversionSpecifierPositionInStorage(storage, _Indices)}...}};
+        GetConversionSpecifierPositionInStorage(storage, _Indices),
+        GetFastFormat(fmt, _Indices), GetStaticPrecision(fmt, _Indices)}...}};
 }
 
 /**
@@ -1258,42 +1613,48 @@ GetParamSize(const ParamType& param_type, _Tp arg) {
 
 /**
  * @brief
- * 获取传给格式串的实参中除了非字符串类型大小数组。
- * 例如对于 ("%d %s\n", getInt(), getString().c_str()) 的实参
- * 会返回 [sizeof(int), 0]。
- *
- * @tparam _NumParam
- * @tparam _Args
- * @param args
- * @return std::array<size_t, _NumParam>
+ * 实参类型的列表，由 ArgTypes 在不求值的语境中推导。
+ */
+template <typename... _Args>
+struct ArgTypeList {};
+
+/**
+ * @brief
+ * 以与 Log 相同的方式（按值传递）推导实参类型。只用于 decltype，
+ * 不会对实参求值。
  */
-// template <size_t _NumParam, typename... _Args>
-// std::array<size_t, _NumParam> GetParamSizes(_Args... args) {
-//     return {{GetParamSize(args)...}};
-// }
-
-template <size_t _Indices = 0, size_t _NumParam, typename _FirstArg,
-          typename... _RestArgs>
-void GetParamSizes(const std::array<ParamType, _NumParam>& param_types,
-                   std::array<size_t, _NumParam>& param_sizes, _FirstArg first,
-                   _RestArgs... rest) {
-    param_sizes[_Indices] = GetParamSize(param_types[_Indices], first);
-    GetParamSizes<_Indices + 1>(param_types, param_sizes, rest...);
+template <typename... _Args>
+ArgTypeList<_Args...> ArgTypes(_Args... args);
+
+template <size_t _NumParam, typename... _Args, size_t... _Indices>
+constexpr std::array<size_t, _NumParam> MakeParamSizesHelper(
+    const std::array<ParamType, _NumParam>& param_types,
+    std::index_sequence<_Indices...>) {
+    return {{GetParamSize(param_types[_Indices], _Args())...}};
 }
 
 /**
  * @brief
- * GetParamSizes 的无参类型。
+ * 在编译期根据实参类型生成实参中除了字符串类型的大小数组，
+ * 使调用点的静态信息可以在编译期完整构造。
+ * 例如对于 ("%d %s\n", getInt(), getString().c_str()) 的实参
+ * 会返回 [sizeof(int), 0]。
+ * 参数数量与实参数量不同时返回全 0，由 Log 中的 static_assert 报告错误。
  *
- * @tparam _Indices
  * @tparam _NumParam
+ * @tparam _Args 实参类型。
  * @param param_types
- * @param param_sizes
+ * @return std::array<size_t, _NumParam>
  */
-template <size_t _Indices = 0, size_t _NumParam>
-void GetParamSizes(const std::array<ParamType, _NumParam>& param_types,
-                   std::array<size_t, _NumParam>& param_sizes) {
-    return;
+template <size_t _NumParam, typename... _Args>
+constexpr std::array<size_t, _NumParam> MakeParamSizes(
+    const std::array<ParamType, _NumParam>& param_types,
+    ArgTypeList<_Args...>) {
+    if constexpr (sizeof...(_Args) == _NumParam)
+        return MakeParamSizesHelper<_NumParam, _Args...>(
+            param_types, std::make_index_sequence<_NumParam>());
+    else
+        return {};
 }
 
 /**
@@ -2,21 +2,93 @@
 
 #include <liburing.h>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <ios>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 
+#include "binary_log.h"
 #include "buffers.h"
 #include "fcntl.h"
+#include "fnmatch.h"
+#include "linux/falloc.h"
 #include "log_info.h"
+#include "registry.h"
+#include "sys/stat.h"
 #include "unistd.h"
 
+// liburing 2.6 开始提供 io_uring_prep_ftruncate，较早的版本直接截断。
+#if defined(IO_URING_VERSION_MAJOR) &&  \
+    (IO_URING_VERSION_MAJOR > 2 ||      \
+     (IO_URING_VERSION_MAJOR == 2 && IO_URING_VERSION_MINOR >= 6))
+#define OLOG_HAS_IO_URING_FTRUNCATE 1
+#else
+#define OLOG_HAS_IO_URING_FTRUNCATE 0
+#endif
+
+// 链接器为 olog_static_info 段生成的起止符号。没有任何调用点写入该段时
+// 两者都为空，弱引用避免链接失败。
+extern "C" {
+extern const olog::logger::StaticInfoEntry __start_olog_static_info[]
+    __attribute__((weak));
+extern const olog::logger::StaticInfoEntry __stop_olog_static_info[]
+    __attribute__((weak));
+}
+
 namespace olog {
 namespace logger {
 
+namespace {
+
+// 报告丢弃日志数量时使用的格式串，参数为数量和原因。
+constexpr char DROPPED_RECORDS_FORMAT[] =
+    "%lu log records were dropped because %s";
+
+// 丢弃日志的原因。
+constexpr char STAGING_BUFFER_FULL[] = "the staging buffer was full";
+constexpr char SINK_TOO_SLOW[] = "the sink was too slow";
+constexpr size_t DROPPED_RECORDS_NUM_PARAMS =
+    log_info::FormatParametersCount(DROPPED_RECORDS_FORMAT);
+constexpr size_t DROPPED_RECORDS_NUM_CONVERSIONS =
+    log_info::ConversionSpecifiersCount(DROPPED_RECORDS_FORMAT);
+constexpr size_t DROPPED_RECORDS_STORAGE_SIZE =
+    log_info::SizeConversionStorageNeeds(DROPPED_RECORDS_FORMAT);
+constexpr std::array<log_info::ParamType, DROPPED_RECORDS_NUM_PARAMS>
+    DROPPED_RECORDS_PARAM_TYPES =
+        log_info::AnalyzeFormatParameters<DROPPED_RECORDS_NUM_PARAMS>(
+            DROPPED_RECORDS_FORMAT);
+constexpr std::array<char, DROPPED_RECORDS_STORAGE_SIZE>
+    DROPPED_RECORDS_CONVERSION_STORAGE =
+        log_info::MakeConversionStorage<DROPPED_RECORDS_STORAGE_SIZE>(
+            DROPPED_RECORDS_FORMAT);
+constexpr std::array<log_info::FormatFragment, DROPPED_RECORDS_NUM_CONVERSIONS>
+    DROPPED_RECORDS_FORMAT_FRAGMENTS =
+        log_info::GetFormatFragments<DROPPED_RECORDS_NUM_CONVERSIONS>(
+            DROPPED_RECORDS_FORMAT, DROPPED_RECORDS_CONVERSION_STORAGE);
+constexpr std::array<size_t, DROPPED_RECORDS_NUM_PARAMS>
+    DROPPED_RECORDS_PARAM_SIZES = log_info::MakeParamSizes(
+        DROPPED_RECORDS_PARAM_TYPES,
+        log_info::ArgTypeList<uint64_t, const char*>());
+constexpr log_info::StaticLogInfo DROPPED_RECORDS_STATIC_INFO(
+    __FILE__, __LINE__, log_info::LogLevel::WARNING,
+    sizeof(DROPPED_RECORDS_FORMAT), DROPPED_RECORDS_NUM_CONVERSIONS,
+    DROPPED_RECORDS_NUM_PARAMS, DROPPED_RECORDS_FORMAT,
+    DROPPED_RECORDS_CONVERSION_STORAGE.data(),
+    DROPPED_RECORDS_FORMAT_FRAGMENTS.data(),
+    DROPPED_RECORDS_PARAM_TYPES.data(), DROPPED_RECORDS_PARAM_SIZES.data());
+
+}  // namespace
+
 // 初始化 Logger 的静态变量。
 thread_local buffers::StagingBuffer* Logger::staging_buffer_ = nullptr;
+thread_local Logger* Logger::thread_logger_ = nullptr;
 thread_local buffers::StagingBuffer::DestructGuard
     Logger::staging_buffer_destruct_guard_ = {};
 
@@ -26,50 +98,155 @@ Logger& Logger::GetInstance() {
 }
 
 Logger::Logger()
-    : current_log_level_(log_info::LogLevel::INFO),
-      output_fd_(STDOUT_FILENO),
+    : output_fd_(STDOUT_FILENO),
+      pending_output_fd_(-1),
+      compressor_changed_(false),
+      compression_enabled_(false),
+      sinks_changed_(false),
+      next_sink_id_(0),
+      output_format_(OutputFormat::TEXT),
+      timestamp_precision_(log_info::TimestampPrecision::MILLISECOND),
+      ordered_output_(false),
+      overflow_policy_(OverflowPolicy::BLOCK),
+      max_flush_latency_ns_(config::DEFAULT_MAX_FLUSH_LATENCY_NS),
+      write_mode_(WriteMode::APPEND),
+      durability_policy_(DurabilityPolicy::EVERY_WRITE),
+      rotation_size_(0),
+      rotation_interval_ns_(0),
+      consumer_parked_(0),
       ring(),
-      num_sqes_(0) {
-    buffer_for_log_ = std::make_unique<char[]>(config::DOUBLE_BUFFER_SIZE);
-    buffer_for_io_ = std::make_unique<char[]>(config::DOUBLE_BUFFER_SIZE);
+      num_sqes_(0),
+      log_buffer_idx_(0),
+      output_file_index_(0),
+      buffers_registered_(false),
+      files_registered_(false),
+      sqpoll_enabled_(false),
+      io_uring_features_(0),
+      sync_requested_(false),
+      has_unsynced_writes_(false),
+      last_sync_tsc_(0),
+      output_positioned_(false),
+      output_offset_(0),
+      preallocated_end_(0),
+      preallocating_(false),
+      preallocation_failed_(false),
+      output_direct_(false),
+      carried_bytes_(0),
+      carried_block_written_(false),
+      output_file_flags_(-1),
+      output_file_size_(0),
+      output_file_start_ns_(0),
+      rotation_state_(RotationState::IDLE),
+      rotated_fd_(-1),
+      retiring_fd_(-1),
+      retiring_size_(0),
+      retiring_trim_(false),
+      rotation_failed_(false),
+      ftruncate_unsupported_(false),
+      compressing_(false),
+      active_output_format_(OutputFormat::TEXT),
+      dropped_records_log_id_(log_info::UNREGISTERED_LOG_ID),
+      binary_header_written_(false),
+      binary_calibration_written_(false),
+      num_dumped_info_(0),
+      consumer_should_exit_(false) {
+    registerLinkTimeLogInfo();
+
+    log_assembler_.setTscCalibration(tsc_clock_.getCalibration());
+    sink_assembler_.setTscCalibration(tsc_clock_.getCalibration());
 
-    int ret = io_uring_queue_init(config::IO_URING_ENTRIES, &ring,
-                                  config::IO_URING_INIT_FLAGS);
+    output_buffers_.resize(config::NUM_OUTPUT_BUFFERS);
+    for (size_t idx = 0; idx < output_buffers_.size(); ++idx) {
+        output_buffers_[idx].data_.reset(static_cast<char*>(std::aligned_alloc(
+            config::DIRECT_IO_ALIGNMENT, config::OUTPUT_BUFFER_SIZE)));
+        if (output_buffers_[idx].data_ == nullptr)
+            throw std::bad_alloc();
+        if (idx != log_buffer_idx_)
+            free_output_buffers_.push_back(idx);
+    }
+
+    // 内核不支持 SQPOLL 或权限不足时退回普通模式。
+    int ret = initIoUring(config::IO_URING_SQPOLL);
+    if (ret < 0 && sqpoll_enabled_)
+        ret = initIoUring(false);
 
     if (ret < 0) {
         fprintf(stderr, "OLog can't init io_uring queue: %s", strerror(-ret));
         exit(EXIT_FAILURE);
     }
 
+    registerIoResources();
+
     consumer_thread_ = std::thread(&Logger::consumerThreadMain, this);
 }
 
 Logger::~Logger() {
-    consumer_should_exit_ = true;
+    consumer_should_exit_.store(true);
+    wakeUpConsumer();
     if (consumer_thread_.joinable())
         consumer_thread_.join();
 #ifdef OLOG_ENABLE_LOGGER_DEBUG_PRINTTING
     printf("Logger: remaining number of producer buffers is: %ld\n",
            producer_buffers_.size());
 #endif
+    trimOutputFile();
     if (output_fd_ > 0 && output_fd_ != STDOUT_FILENO)
         close(output_fd_);
+    int pending_fd = pending_output_fd_.exchange(-1);
+    if (pending_fd >= 0)
+        close(pending_fd);
+    if (rotated_fd_ >= 0)
+        close(rotated_fd_);
+    for (const Sink& sink : sinks_) {
+        if (sink.owns_fd_)
+            close(sink.fd_);
+    }
+    for (const Sink& sink : pending_sinks_) {
+        if (sink.owns_fd_)
+            close(sink.fd_);
+    }
     io_uring_queue_exit(&ring);
 }
 
-void Logger::registerLogInfoInternal(int& log_id,
-                                     log_info::StaticLogInfo static_log_info) {
-    std::lock_guard<std::mutex> lock(registered_info_mtx_);
+void Logger::registerLinkTimeLogInfo() {
+    std::lock_guard<std::mutex> lock(log_sites_mtx_);
+    for (const StaticInfoEntry* entry = __start_olog_static_info;
+         entry != __stop_olog_static_info; ++entry) {
+        // 同一调用点的多个条目只注册一次。OLOG_LIMITED 的两个格式串
+        // 共用一个调用点状态，同样只登记一次。
+        const log_info::StaticLogInfo& static_info = *entry->static_info_;
+        if (entry->log_id_->load(std::memory_order_relaxed) ==
+            log_info::UNREGISTERED_LOG_ID)
+            entry->log_id_->store(
+                static_cast<int>(registered_info_.add(static_info)),
+                std::memory_order_relaxed);
+        if (entry->site_state_->load(std::memory_order_relaxed) ==
+            LogSiteState::UNREGISTERED)
+            addLogSite(*entry->site_state_, static_info.filename_,
+                       static_cast<int>(static_info.line_number_),
+                       static_info.format_str_);
+    }
+}
 
-    if (log_id != log_info::UNREGISTERED_LOG_ID)
+void Logger::registerLogInfoInternal(
+    std::atomic<int>& log_id, const log_info::StaticLogInfo& static_log_info) {
+    // 先占用 log_id 再分配 id。同时第一次执行同一调用点的线程中只有一个
+    // 向注册表添加静态信息，二进制输出的格式字典中不会出现多余的条目。
+    int expected = log_info::UNREGISTERED_LOG_ID;
+    if (!log_id.compare_exchange_strong(expected, log_info::RESERVED_LOG_ID,
+                                        std::memory_order_relaxed)) {
+        // 其他线程正在注册，等待它分配的 id。
+        while (log_id.load(std::memory_order_acquire) ==
+               log_info::RESERVED_LOG_ID)
+            std::this_thread::yield();
         return;
+    }
 
-    // 为其分配 id。
-    log_id = static_cast<int>(registered_info_.size());
-    registered_info_.emplace_back(std::move(static_log_info));
+    int new_id = static_cast<int>(registered_info_.add(static_log_info));
+    log_id.store(new_id, std::memory_order_release);
 
 #ifdef OLOG_ENABLE_LOGGER_DEBUG_PRINTTING
-    printf("Logger assigned id: %d for: \n", log_id);
+    printf("Logger assigned id: %d for: \n", new_id);
     printf("  %s:%d \"%s\"\n", static_log_info.filename_,
            static_log_info.line_number_, static_log_info.format_str_);
 #endif
@@ -79,7 +256,79 @@ void Logger::setLogLevelInternal(log_info::LogLevel level) {
     if (level >= log_info::LogLevel::NUMBER_OF_LOG_LEVELS)
         level = static_cast<log_info::LogLevel>(
             static_cast<uint8_t>(log_info::LogLevel::NUMBER_OF_LOG_LEVELS) - 1);
-    current_log_level_ = level;
+    current_log_level.store(static_cast<uint8_t>(level),
+                            std::memory_order_relaxed);
+}
+
+bool Logger::LogSiteRule::matches(const LogSite& site) const {
+    // 不使用 FNM_PATHNAME，通配符可以匹配路径中的 '/'。
+    if (!file_glob_.empty() &&
+        fnmatch(file_glob_.c_str(), site.filename_, 0) != 0)
+        return false;
+    if (line_number_ != 0 && line_number_ != site.line_number_)
+        return false;
+    return format_substring_.empty() ||
+           strstr(site.format_, format_substring_.c_str()) != nullptr;
+}
+
+LogSiteState Logger::registerLogSiteInternal(std::atomic<LogSiteState>& state,
+                                             const char* filename,
+                                             int line_number,
+                                             const char* format) {
+    // 链接时收集的调用点在构造 Logger 时已经登记，不需要加锁。
+    LogSiteState site_state = state.load(std::memory_order_relaxed);
+    if (site_state != LogSiteState::UNREGISTERED)
+        return site_state;
+
+    std::lock_guard<std::mutex> lock(log_sites_mtx_);
+
+    // 多个线程同时第一次执行同一调用点时只登记一次。
+    site_state = state.load(std::memory_order_relaxed);
+    if (site_state != LogSiteState::UNREGISTERED)
+        return site_state;
+    return addLogSite(state, filename, line_number, format);
+}
+
+LogSiteState Logger::addLogSite(std::atomic<LogSiteState>& state,
+                                const char* filename, int line_number,
+                                const char* format) {
+    log_sites_.push_back(LogSite{filename, line_number, format, &state});
+    LogSiteState site_state = LogSiteState::BY_LEVEL;
+    for (const LogSiteRule& rule : log_site_rules_) {
+        if (rule.matches(log_sites_.back()))
+            site_state = rule.state_;
+    }
+    state.store(site_state, std::memory_order_relaxed);
+    return site_state;
+}
+
+size_t Logger::addLogSiteRule(const char* file_glob, int line_number,
+                              const char* format_substring,
+                              LogSiteState state) {
+    LogSiteRule rule;
+    rule.file_glob_ = file_glob != nullptr ? file_glob : "";
+    rule.line_number_ = line_number;
+    rule.format_substring_ =
+        format_substring != nullptr ? format_substring : "";
+    rule.state_ = state;
+
+    std::lock_guard<std::mutex> lock(log_sites_mtx_);
+    size_t num_matched = 0;
+    for (const LogSite& site : log_sites_) {
+        if (!rule.matches(site))
+            continue;
+        site.state_->store(state, std::memory_order_relaxed);
+        ++num_matched;
+    }
+    log_site_rules_.push_back(std::move(rule));
+    return num_matched;
+}
+
+void Logger::resetLogSitesInternal() {
+    std::lock_guard<std::mutex> lock(log_sites_mtx_);
+    log_site_rules_.clear();
+    for (const LogSite& site : log_sites_)
+        site.state_->store(LogSiteState::BY_LEVEL, std::memory_order_relaxed);
 }
 
 void Logger::setLogFileInternal(const char* filename) {
@@ -90,8 +339,18 @@ void Logger::setLogFileInternal(const char* filename) {
         throw std::ios_base::failure(err_msg);
     }
 
-    // 尝试打开文件。
-    int new_fd = open(filename, config::LOG_FILE_FLAGS, 0666);
+    // 带偏移量写入时由日志线程决定写入位置，不使用 O_APPEND。
+    WriteMode write_mode = write_mode_.load(std::memory_order_relaxed);
+    int flags = config::LOG_FILE_FLAGS;
+    if (write_mode != WriteMode::APPEND)
+        flags &= ~O_APPEND;
+
+    // 尝试打开文件。文件系统不支持 O_DIRECT 时退回普通的带偏移量写入。
+    int new_fd = -1;
+    if (write_mode == WriteMode::DIRECT)
+        new_fd = open(filename, flags | O_DIRECT, 0666);
+    if (new_fd < 0)
+        new_fd = open(filename, flags, 0666);
     if (new_fd < 0) {
         std::string err_msg = "Can't open file: ";
         err_msg.append(filename);
@@ -100,135 +359,1402 @@ void Logger::setLogFileInternal(const char* filename) {
         throw std::ios_base::failure(err_msg);
     }
 
-    if (output_fd_ > 0)
-        close(output_fd_);
-    output_fd_ = new_fd;
+    // 轮转时按绝对路径重命名，不受之后更改工作目录的影响。
+    char* real_path = realpath(filename, nullptr);
+    std::string path = real_path != nullptr ? real_path : filename;
+    free(real_path);
+
+    // 由日志线程在写完之前的日志后换上新文件。
+    std::lock_guard<std::mutex> lock(pending_output_mtx_);
+    pending_output_path_ = std::move(path);
+    int replaced_fd = pending_output_fd_.exchange(new_fd);
+    if (replaced_fd >= 0)
+        close(replaced_fd);
 }
 
-void Logger::updateShadowRegisteredInfo() {
-    std::lock_guard<std::mutex> lock(registered_info_mtx_);
-    for (auto i = shadow_registered_info_.size(); i < registered_info_.size();
-         ++i) {
-        shadow_registered_info_.push_back(registered_info_[i]);
+void Logger::setCompressorInternal(
+    std::unique_ptr<compression::Compressor> compressor) {
+    std::lock_guard<std::mutex> lock(pending_output_mtx_);
+    compression_enabled_.store(compressor != nullptr,
+                               std::memory_order_relaxed);
+    pending_compressor_ = std::move(compressor);
+    compressor_changed_.store(true, std::memory_order_relaxed);
+}
+
+int Logger::addSinkInternal(const char* filename, log_info::LogLevel max_level,
+                            OutputFormat format) {
+    if (access(filename, F_OK) == 0 && access(filename, R_OK | W_OK) != 0) {
+        std::string err_msg = "Unable to read/write file: ";
+        err_msg.append(filename);
+        throw std::ios_base::failure(err_msg);
+    }
+
+    int fd = open(filename, config::LOG_FILE_FLAGS, 0666);
+    if (fd < 0) {
+        std::string err_msg = "Can't open file: ";
+        err_msg.append(filename);
+        err_msg.append(": ");
+        err_msg.append(strerror(errno));
+        throw std::ios_base::failure(err_msg);
+    }
+
+    try {
+        return addSinkInternal(fd, true, max_level, format);
+    } catch (...) {
+        close(fd);
+        throw;
     }
 }
 
-int Logger::waitForIoUring() {
-    if (num_sqes_ == 0)
-        return 0;
-    io_uring_cqe* cqe = nullptr;
-    int ret = io_uring_wait_cqe(&ring, &cqe);
-    if (ret == 0)
-        io_uring_cqe_seen(&ring, cqe);
+int Logger::addSinkInternal(int fd, bool owns_fd, log_info::LogLevel max_level,
+                            OutputFormat format) {
+    Sink sink;
+    sink.fd_ = fd;
+    sink.owns_fd_ = owns_fd;
+    sink.max_level_ = max_level;
+    sink.format_ = format;
+    sink.buffers_[0].reset(new char[config::SINK_BUFFER_SIZE]);
+    sink.buffers_[1].reset(new char[config::SINK_BUFFER_SIZE]);
+    sink.active_ = 0;
+    sink.nbytes_ = 0;
+    sink.writing_ = false;
+    sink.write_bytes_ = 0;
+    sink.written_bytes_ = 0;
+    sink.binary_header_written_ = false;
+    sink.binary_calibration_written_ = false;
+    sink.num_dumped_info_ = 0;
+    sink.num_dropped_ = 0;
+
+    // 由日志线程在处理之后的日志前换上。
+    std::lock_guard<std::mutex> lock(pending_output_mtx_);
+    if (live_sink_ids_.size() >= config::MAX_SINKS)
+        throw std::length_error("Too many OLog sinks");
+    sink.id_ = next_sink_id_++;
+    live_sink_ids_.push_back(sink.id_);
+    pending_sinks_.push_back(std::move(sink));
+    sinks_changed_.store(true, std::memory_order_relaxed);
+    return live_sink_ids_.back();
+}
+
+void Logger::removeSinkInternal(int sink_id) {
+    std::lock_guard<std::mutex> lock(pending_output_mtx_);
+    auto it = std::find(live_sink_ids_.begin(), live_sink_ids_.end(), sink_id);
+    if (it == live_sink_ids_.end())
+        return;
+    live_sink_ids_.erase(it);
+    pending_sink_removals_.push_back(sink_id);
+    sinks_changed_.store(true, std::memory_order_relaxed);
+}
+
+void Logger::applySinkChanges() {
+    if (!sinks_changed_.load(std::memory_order_relaxed))
+        return;
+
+    std::vector<Sink> added_sinks;
+    std::vector<int> removed_ids;
+    {
+        std::lock_guard<std::mutex> lock(pending_output_mtx_);
+        sinks_changed_.store(false, std::memory_order_relaxed);
+        added_sinks.swap(pending_sinks_);
+        removed_ids.swap(pending_sink_removals_);
+    }
+
+    // 先添加再移除，添加后立即被移除的输出也会被正确关闭。
+    for (Sink& sink : added_sinks)
+        sinks_.push_back(std::move(sink));
+
+    for (int sink_id : removed_ids) {
+        for (size_t index = 0; index < sinks_.size(); ++index) {
+            if (sinks_[index].id_ != sink_id)
+                continue;
+
+            // 写出缓冲区中剩余的日志，文件在写入全部完成后才能关闭。
+            flushSink(index, true);
+            while (sinks_[index].writing_)
+                reapCompletions(true);
+            if (sinks_[index].owns_fd_)
+                close(sinks_[index].fd_);
+            sinks_.erase(sinks_.begin() + index);
+            break;
+        }
+    }
+}
+
+void Logger::applyOutputSettings() {
+    log_assembler_.setTimestampPrecision(
+        timestamp_precision_.load(std::memory_order_relaxed));
+    sink_assembler_.setTimestampPrecision(
+        timestamp_precision_.load(std::memory_order_relaxed));
+    applySinkChanges();
+
+    OutputFormat new_format = output_format_.load(std::memory_order_relaxed);
+    if (pending_output_fd_.load(std::memory_order_relaxed) < 0 &&
+        !compressor_changed_.load(std::memory_order_relaxed) &&
+        new_format == active_output_format_)
+        return;
+
+    int new_fd = -1;
+    std::string new_path;
+    bool compressor_changed = false;
+    std::unique_ptr<compression::Compressor> new_compressor;
+    {
+        std::lock_guard<std::mutex> lock(pending_output_mtx_);
+        new_fd = pending_output_fd_.exchange(-1);
+        new_path = std::move(pending_output_path_);
+        compressor_changed = compressor_changed_.exchange(false);
+        new_compressor = std::move(pending_compressor_);
+    }
+
+    // 将缓冲区中的日志写入原来的文件。
+    if (hasUnsubmittedOutput()) {
+        swapOutputBuffer(getWritedBytes(), false);
+        resetAssemblerBuffer();
+    }
+
+    if (compressor_changed) {
+        // 压缩线程中的缓冲区仍使用原来的压缩器。压缩后不再使用 O_DIRECT，
+        // 先去掉之前写入的填充，再重新计算写入的位置。
+        waitForAllWrites();
+        trimOutputFile();
+        compressing_ = new_compressor != nullptr;
+        if (compressing_ && compression_worker_ == nullptr) {
+            for (OutputBuffer& buffer : output_buffers_)
+                buffer.frame_data_.reset(new char[compression::GetMaxFrameSize(
+                    config::OUTPUT_BUFFER_SIZE)]);
+            compression_worker_ =
+                std::make_unique<compression::CompressionWorker>(
+                    [this] { wakeUpConsumer(); });
+        }
+        if (compression_worker_ != nullptr)
+            compression_worker_->setCompressor(std::move(new_compressor));
+        initOutputOffset();
+    }
+
+    if (new_fd >= 0) {
+        // 原来的文件要在写入全部完成后才能关闭。进行中的轮转也随之完成，
+        // 为原来的文件打开的新文件不再需要。
+        waitForAllWrites();
+        if (rotated_fd_ >= 0)
+            close(rotated_fd_);
+        rotated_fd_ = -1;
+        rotation_state_ = RotationState::IDLE;
+        rotation_failed_ = false;
+
+        trimOutputFile();
+        if (output_fd_ > 0 && output_fd_ != STDOUT_FILENO)
+            close(output_fd_);
+        output_fd_ = new_fd;
+        output_path_ = std::move(new_path);
+        initOutputOffset();
+
+        // 注册的文件表持有原来文件的引用，替换为新文件。
+        // 替换失败时退回使用普通的文件描述符。
+        if (files_registered_ &&
+            io_uring_register_files_update(&ring, output_file_index_,
+                                           &output_fd_, 1) < 0)
+            files_registered_ = false;
+    }
+
+    // 新文件或新格式都需要重新写出二进制文件头和静态信息。
+    active_output_format_ = new_format;
+    binary_header_written_ = false;
+    binary_calibration_written_ = false;
+    num_dumped_info_ = 0;
+    resetAssemblerBuffer();
+}
+
+int Logger::initIoUring(bool use_sqpoll) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = config::IO_URING_INIT_FLAGS;
+    if (use_sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = config::IO_URING_SQPOLL_IDLE_MS;
+        if (config::IO_URING_SQPOLL_CPU >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = config::IO_URING_SQPOLL_CPU;
+        }
+    }
+
+    int ret =
+        io_uring_queue_init_params(config::IO_URING_ENTRIES, &ring, &params);
+    sqpoll_enabled_ = use_sqpoll;
+    io_uring_features_ = ret == 0 ? params.features : 0;
+
+    // 较早的内核在 SQPOLL 模式下只能使用注册的文件，而附加输出、
+    // 轮转时的文件操作以及注册失败的文件都使用普通的文件描述符。
+    if (ret == 0 && use_sqpoll &&
+        !(io_uring_features_ & SQPOLL_NONFIXED_FEATURE)) {
+        io_uring_queue_exit(&ring);
+        ret = -EOPNOTSUPP;
+    }
+
+#ifdef OLOG_ENABLE_LOGGER_DEBUG_PRINTTING
+    if (ret < 0 && use_sqpoll)
+        fprintf(stderr, "Logger can't enable SQPOLL: %s\n", strerror(-ret));
+#endif
+    return ret;
+}
+
+void Logger::registerIoResources() {
+    std::vector<iovec> iovecs(output_buffers_.size());
+    for (size_t idx = 0; idx < output_buffers_.size(); ++idx) {
+        iovecs[idx].iov_base = output_buffers_[idx].data_.get();
+        iovecs[idx].iov_len = config::OUTPUT_BUFFER_SIZE;
+    }
+    int buffers_ret =
+        io_uring_register_buffers(&ring, iovecs.data(), iovecs.size());
+    buffers_registered_ = buffers_ret == 0;
+
+    // 轮转换下的文件使用的位置先同样指向输出文件。
+    int files[NUM_REGISTERED_FILES];
+    std::fill(files, files + NUM_REGISTERED_FILES, output_fd_);
+    int files_ret =
+        io_uring_register_files(&ring, files, NUM_REGISTERED_FILES);
+    files_registered_ = files_ret == 0;
+
+#ifdef OLOG_ENABLE_LOGGER_DEBUG_PRINTTING
+    if (!buffers_registered_)
+        printf("Logger can't register output buffers: %s\n",
+               strerror(-buffers_ret));
+    if (!files_registered_)
+        printf("Logger can't register output file: %s\n",
+               strerror(-files_ret));
+#endif
+}
+
+void Logger::initOutputOffset() {
+    // 标准输出、管道和以 O_APPEND 打开的文件可能还有其他写入者，
+    // 仍然写在文件的当前位置。
+    struct stat file_stat;
+    int file_flags = fcntl(output_fd_, F_GETFL);
+    bool is_regular = fstat(output_fd_, &file_stat) == 0 &&
+                      S_ISREG(file_stat.st_mode) && file_flags >= 0;
+    output_positioned_ = is_regular && (file_flags & O_APPEND) == 0;
+    output_offset_ = output_positioned_ ? file_stat.st_size : 0;
+    preallocated_end_ = output_offset_;
+    preallocating_ = false;
+    preallocation_failed_ = false;
+
+    // 从文件当前的大小和打开的时间开始计算轮转的条件。
+    output_file_flags_ = is_regular ? file_flags : -1;
+    output_file_size_ = is_regular ? file_stat.st_size : 0;
+    output_file_start_ns_ = utils::GetNsSteadyClockInterval();
+
+    // 原来的文件中带过来的块不属于新文件。
+    output_direct_ = output_positioned_ && (file_flags & O_DIRECT) != 0;
+    carried_bytes_ = 0;
+    carried_block_written_ = false;
+
+    size_t tail_bytes = output_offset_ % config::DIRECT_IO_ALIGNMENT;
+    if (!output_direct_ || (tail_bytes == 0 && !compressing_))
+        return;
+
+    // 末尾不完整的块已经在文件中，之后会连同新日志一起重写。
+    // 读取失败时不再使用 O_DIRECT。压缩后的帧长度不定，无法按块写出，
+    // 这时同样不使用 O_DIRECT。
+    ssize_t ret = -1;
+    if (!compressing_)
+        ret = pread(output_fd_, output_buffers_[log_buffer_idx_].data_.get(),
+                    config::DIRECT_IO_ALIGNMENT, output_offset_ - tail_bytes);
+    if (ret == static_cast<ssize_t>(tail_bytes)) {
+        carried_bytes_ = tail_bytes;
+    } else {
+        fcntl(output_fd_, F_SETFL, file_flags & ~O_DIRECT);
+        output_file_flags_ &= ~O_DIRECT;
+        output_direct_ = false;
+    }
+}
+
+void Logger::preallocateOutputFile() {
+    // 一次只预分配一段，全部输出缓冲区写出后仍在已分配的空间内时不需要预分配。
+    const int64_t lookahead = static_cast<int64_t>(config::OUTPUT_BUFFER_SIZE *
+                                                   config::NUM_OUTPUT_BUFFERS);
+    if (preallocating_ || preallocation_failed_ ||
+        output_offset_ + lookahead <= preallocated_end_)
+        return;
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr)
+        return;
+
+    // FALLOC_FL_KEEP_SIZE 不改变文件大小，读取日志时看不到预分配的空间。
+    int64_t offset = std::max(preallocated_end_, output_offset_);
+    int file_index = getRegisteredFileIndex(output_fd_);
+    io_uring_prep_fallocate(sqe, file_index >= 0 ? file_index : output_fd_,
+                            FALLOC_FL_KEEP_SIZE, offset,
+                            config::PREALLOCATION_EXTENT_SIZE);
+    if (file_index >= 0)
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    io_uring_sqe_set_data64(sqe, PREALLOCATION_REQUEST);
+
+    int ret = io_uring_submit(&ring);
+    if (ret > 0) {
+        num_sqes_ += ret;
+        preallocating_ = true;
+        preallocated_end_ = offset + config::PREALLOCATION_EXTENT_SIZE;
+    }
+}
+
+void Logger::trimOutputFile() {
+    // 截断到文件当前的大小时，文件系统也会释放末尾之后的预分配空间。
+    if (output_positioned_ &&
+        (output_direct_ || preallocated_end_ > output_offset_) &&
+        ftruncate(output_fd_, output_offset_) < 0)
+        fprintf(stderr, "OLog can't trim the log file: %s\n",
+                strerror(errno));
+}
+
+void Logger::rotateOutputFileIfNeeded(bool is_full) {
+    if (output_path_.empty() || output_file_flags_ < 0 || rotation_failed_)
+        return;
+
+    if (rotation_state_ == RotationState::READY && !is_full) {
+        switchToRotatedFile();
+        return;
+    }
+    if (rotation_state_ == RotationState::RETIRING) {
+        closeRetiringFileIfIdle();
+        return;
+    }
+    if (rotation_state_ != RotationState::IDLE)
+        return;
+
+    // 使用单调时钟，系统时间被向前或向后调整时不影响轮转的间隔。
+    uint64_t rotation_size = rotation_size_.load(std::memory_order_relaxed);
+    int64_t rotation_interval_ns =
+        rotation_interval_ns_.load(std::memory_order_relaxed);
+    if ((rotation_size > 0 && output_file_size_ >= rotation_size) ||
+        (rotation_interval_ns > 0 &&
+         utils::GetNsSteadyClockInterval() - output_file_start_ns_ >=
+             rotation_interval_ns))
+        submitRotation();
+}
+
+void Logger::submitRotation() {
+    // 重命名和打开新文件链接在一起，必须同时取得两个 sqe。
+    if (io_uring_sq_space_left(&ring) < 2)
+        return;
+
+    // 归档文件名带有精确到毫秒的本地时间，如 app.log.20240101-120000-000。
+    int64_t now_ms = utils::GetMsSystemClockInterval();
+    time_t now_sec = static_cast<time_t>(now_ms / 1000);
+    struct tm now_tm;
+    localtime_r(&now_sec, &now_tm);
+    char suffix[32];
+    size_t len = strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &now_tm);
+    snprintf(suffix + len, sizeof(suffix) - len, "-%03d",
+             static_cast<int>(now_ms % 1000));
+    rotation_archive_path_ = output_path_ + suffix;
+
+    // 同一毫秒内已经轮转过时，RENAME_NOREPLACE 使 renameat 失败，
+    // 不会覆盖之前的归档文件。
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_renameat(sqe, AT_FDCWD, output_path_.c_str(), AT_FDCWD,
+                           rotation_archive_path_.c_str(), RENAME_NOREPLACE);
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+    io_uring_sqe_set_data64(sqe, ROTATION_RENAME_REQUEST);
+
+    // 重命名完成后才在原来的文件名上创建新文件。
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_openat(sqe, AT_FDCWD, output_path_.c_str(),
+                         output_file_flags_ | O_CREAT, 0666);
+    io_uring_sqe_set_data64(sqe, ROTATION_OPEN_REQUEST);
+
+    int ret = io_uring_submit(&ring);
+    if (ret > 0) {
+        num_sqes_ += ret;
+        rotation_state_ = RotationState::OPENING;
+    }
+}
+
+void Logger::switchToRotatedFile() {
+    // 压缩中的缓冲区属于原来的文件，写入的位置按原来的文件计算。
+    // 这里只等待压缩线程，不等待任何文件操作。
+    while (compression_worker_ != nullptr &&
+           compression_worker_->hasPendingJobs())
+        submitCompressedBuffers(true);
+
+    retiring_fd_ = output_fd_;
+    retiring_size_ = output_offset_;
+    retiring_trim_ = output_positioned_ &&
+                     (output_direct_ || preallocated_end_ > output_offset_);
+    bool preallocating = preallocating_;
+
+    // 新文件放在注册的文件表的另一个位置，进行中的请求仍引用原来的文件。
+    output_fd_ = rotated_fd_;
+    rotated_fd_ = -1;
+    if (files_registered_ &&
+        io_uring_register_files_update(&ring, output_file_index_ ^ 1,
+                                       &output_fd_, 1) < 0)
+        files_registered_ = false;
+    if (files_registered_)
+        output_file_index_ ^= 1;
+    initOutputOffset();
+    // 原来文件的预分配完成之前不为新文件预分配。
+    preallocating_ = preallocating;
+
+    // 新文件需要重新写出二进制文件头和静态信息。
+    binary_header_written_ = false;
+    binary_calibration_written_ = false;
+    num_dumped_info_ = 0;
+
+    rotation_state_ = RotationState::RETIRING;
+    closeRetiringFileIfIdle();
+}
+
+void Logger::closeRetiringFileIfIdle() {
+    if (rotation_state_ != RotationState::RETIRING || preallocating_)
+        return;
+    for (size_t idx = 0; idx < output_buffers_.size(); ++idx) {
+        if (idx != log_buffer_idx_ &&
+            output_buffers_[idx].fd_ == retiring_fd_ &&
+            std::find(free_output_buffers_.begin(), free_output_buffers_.end(),
+                      idx) == free_output_buffers_.end())
+            return;
+    }
+    rotation_state_ = RotationState::CLOSING;
+    closeRetiringFile(retiring_trim_);
+}
+
+void Logger::closeRetiringFile(bool trim) {
+    // 原来的文件上已经没有进行中的写入，注册的文件表不再引用它。
+    // 截断和关闭使用普通的文件描述符。
+    if (files_registered_)
+        io_uring_register_files_update(&ring, output_file_index_ ^ 1,
+                                       &output_fd_, 1);
+
+    // 取不到两个 sqe 时同样不截断。
+#if OLOG_HAS_IO_URING_FTRUNCATE
+    if (trim && !ftruncate_unsupported_ &&
+        io_uring_sq_space_left(&ring) >= 2) {
+        io_uring_sqe* trim_sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_ftruncate(trim_sqe, retiring_fd_, retiring_size_);
+        io_uring_sqe_set_flags(trim_sqe, IOSQE_IO_LINK);
+        io_uring_sqe_set_data64(trim_sqe, ROTATION_TRIM_REQUEST);
+    }
+#else
+    (void)trim;
+#endif
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr) {
+        close(retiring_fd_);
+        retiring_fd_ = -1;
+        rotation_state_ = RotationState::IDLE;
+        return;
+    }
+    io_uring_prep_close(sqe, retiring_fd_);
+    io_uring_sqe_set_data64(sqe, ROTATION_CLOSE_REQUEST);
+
+    int ret = io_uring_submit(&ring);
+    if (ret > 0)
+        num_sqes_ += ret;
+}
+
+int Logger::getRegisteredFileIndex(int fd) const {
+    if (!files_registered_)
+        return -1;
+    if (fd == output_fd_)
+        return output_file_index_;
+    if (fd == retiring_fd_)
+        return output_file_index_ ^ 1;
+    return -1;
+}
+
+void Logger::handleRotationCompletion(uint64_t request, int res) {
+    switch (request) {
+    case ROTATION_RENAME_REQUEST:
+        // 链接的 openat 会被取消。归档文件已经存在时之后重试。
+        if (res < 0) {
+            rotation_state_ = RotationState::IDLE;
+            if (res != -EEXIST) {
+                rotation_failed_ = true;
+                fprintf(stderr, "OLog can't rename the log file: %s\n",
+                        strerror(-res));
+            }
+        }
+        break;
+
+    case ROTATION_OPEN_REQUEST:
+        if (res >= 0) {
+            rotated_fd_ = res;
+            rotation_state_ = RotationState::READY;
+        } else if (res != -ECANCELED) {
+            rotation_state_ = RotationState::IDLE;
+            rotation_failed_ = true;
+            fprintf(stderr, "OLog can't open the rotated log file: %s\n",
+                    strerror(-res));
+        }
+        break;
+
+    case ROTATION_TRIM_REQUEST:
+        // 链接的 close 会被取消，不截断重新关闭。失败通常是因为
+        // 较早的内核不支持 IORING_OP_FTRUNCATE，之后都不再截断。
+        if (res < 0) {
+            ftruncate_unsupported_ = true;
+            closeRetiringFile(false);
+        }
+        break;
+
+    case ROTATION_CLOSE_REQUEST:
+        if (res == -ECANCELED)
+            break;
+        if (res < 0)
+            fprintf(stderr, "OLog can't close the rotated log file: %s\n",
+                    strerror(-res));
+        retiring_fd_ = -1;
+        rotation_state_ = RotationState::IDLE;
+        break;
+    }
+}
+
+void Logger::updateTscCalibration() {
+    if (!tsc_clock_.recalibrateIfNeeded(config::TSC_CALIBRATION_INTERVAL_NS))
+        return;
+    log_assembler_.setTscCalibration(tsc_clock_.getCalibration());
+    sink_assembler_.setTscCalibration(tsc_clock_.getCalibration());
+    binary_calibration_written_ = false;
+    for (Sink& sink : sinks_)
+        sink.binary_calibration_written_ = false;
+}
+
+void Logger::writeLogRecord(const log_info::DynamicLogInfo* dynamic_log_info,
+                            uint32_t producer_id) {
+    // 同步请求随日志线程本轮最后一次写入提交，那时这条日志已经完整写出。
+    size_t log_id = dynamic_log_info->log_id_;
+    const log_info::StaticLogInfo& static_info = registered_info_.get(log_id);
+    log_info::LogLevel level = static_info.log_level_;
+    if (level <= log_info::LogLevel::ERROR &&
+        durability_policy_.load(std::memory_order_relaxed) ==
+            DurabilityPolicy::ON_ERROR)
+        sync_requested_ = true;
+
+    // 附加输出需要的格式。与日志文件相同的格式复用写入日志文件的内容，
+    // 另一种格式只格式化一次，由该格式的附加输出共享。
+    bool sinks_need_text = false;
+    bool sinks_need_binary = false;
+    for (const Sink& sink : sinks_) {
+        if (level > sink.max_level_)
+            continue;
+        if (sink.format_ == OutputFormat::TEXT)
+            sinks_need_text = true;
+        else
+            sinks_need_binary = true;
+    }
+    sink_text_.clear();
+    sink_binary_.clear();
+
+    if (active_output_format_ == OutputFormat::TEXT) {
+        // 装载对应的静态信息、动态信息和生产者编号，将日志恢复并写入缓冲区。
+        log_assembler_.loadLogInfo(&static_info, dynamic_log_info,
+                                   getStaticPrefix(log_id),
+                                   getProducerPrefix(producer_id));
+        writeAssembled(log_assembler_, sinks_need_text ? &sink_text_ : nullptr);
+    } else {
+        if (!binary_header_written_) {
+            binary_writer_.loadFileHeader();
+            writeAssembled(binary_writer_);
+            binary_header_written_ = true;
+        }
+
+        // 在使用新的校准的动态信息之前写出校准。
+        if (!binary_calibration_written_) {
+            binary_writer_.loadCalibration(tsc_clock_.getCalibration());
+            writeAssembled(binary_writer_);
+            binary_calibration_written_ = true;
+        }
+
+        // 在动态信息之前按顺序写出已注册的静态信息，至少包括它引用的。
+        // 链接时收集的调用点在第一条日志之前全部写出，构成完整的格式字典。
+        while (num_dumped_info_ <
+               std::max(log_id + 1, registered_info_.size())) {
+            binary_writer_.loadStaticInfo(
+                num_dumped_info_, &registered_info_.get(num_dumped_info_));
+            writeAssembled(binary_writer_);
+            ++num_dumped_info_;
+        }
+
+        binary_writer_.loadDynamicInfo(dynamic_log_info, producer_id);
+        writeAssembled(binary_writer_,
+                       sinks_need_binary ? &sink_binary_ : nullptr);
+    }
+
+    if (!sinks_need_text && !sinks_need_binary)
+        return;
+
+    if (sinks_need_text && active_output_format_ != OutputFormat::TEXT) {
+        sink_assembler_.loadLogInfo(&static_info, dynamic_log_info,
+                                    getStaticPrefix(log_id),
+                                    getProducerPrefix(producer_id));
+        assembleToString(sink_assembler_, sink_text_);
+    }
+    if (sinks_need_binary && active_output_format_ != OutputFormat::BINARY) {
+        sink_binary_writer_.loadDynamicInfo(dynamic_log_info, producer_id);
+        assembleToString(sink_binary_writer_, sink_binary_);
+    }
+
+    // 附加输出的缓冲区放不下时丢弃整条日志，之后有空间时报告丢弃的数量。
+    for (size_t index = 0; index < sinks_.size(); ++index) {
+        Sink& sink = sinks_[index];
+        if (level > sink.max_level_)
+            continue;
+        bool appended = sink.num_dropped_ == 0 ||
+                        reportSinkDroppedRecords(index, producer_id);
+        if (appended && sink.format_ == OutputFormat::TEXT)
+            appended = appendToSink(index, sink_text_);
+        else if (appended)
+            appended = writeSinkPreamble(index, log_id) &&
+                       appendToSink(index, sink_binary_);
+        if (!appended)
+            ++sink.num_dropped_;
+    }
+}
+
+bool Logger::writeSinkPreamble(size_t index, size_t log_id) {
+    // 每一段内容写入后才记录为已写出，放不下的部分由之后的日志继续写出。
+    Sink& sink = sinks_[index];
+    if (!sink.binary_header_written_) {
+        sink_preamble_.clear();
+        sink_binary_writer_.loadFileHeader();
+        assembleToString(sink_binary_writer_, sink_preamble_);
+        if (!appendToSink(index, sink_preamble_))
+            return false;
+        sink.binary_header_written_ = true;
+    }
+    if (!sink.binary_calibration_written_) {
+        sink_preamble_.clear();
+        sink_binary_writer_.loadCalibration(tsc_clock_.getCalibration());
+        assembleToString(sink_binary_writer_, sink_preamble_);
+        if (!appendToSink(index, sink_preamble_))
+            return false;
+        sink.binary_calibration_written_ = true;
+    }
+    while (sink.num_dumped_info_ <
+           std::max(log_id + 1, registered_info_.size())) {
+        sink_preamble_.clear();
+        sink_binary_writer_.loadStaticInfo(
+            sink.num_dumped_info_,
+            &registered_info_.get(sink.num_dumped_info_));
+        assembleToString(sink_binary_writer_, sink_preamble_);
+        if (!appendToSink(index, sink_preamble_))
+            return sink.num_dumped_info_ > log_id;
+        ++sink.num_dumped_info_;
+    }
+    return true;
+}
+
+bool Logger::appendToSink(size_t index, const std::string& data) {
+    // 放不下时换上另一个缓冲区。另一个缓冲区仍在写出时不等待，
+    // 慢的附加输出不会阻塞日志文件和生产者。
+    Sink& sink = sinks_[index];
+    if (sink.nbytes_ + data.size() > config::SINK_BUFFER_SIZE)
+        flushSink(index, false);
+    if (sink.nbytes_ + data.size() > config::SINK_BUFFER_SIZE)
+        return false;
+    memcpy(sink.buffers_[sink.active_].get() + sink.nbytes_, data.data(),
+           data.size());
+    sink.nbytes_ += data.size();
+    return true;
+}
+
+bool Logger::reportSinkDroppedRecords(size_t index, uint32_t producer_id) {
+    Sink& sink = sinks_[index];
+    const log_info::DynamicLogInfo* dynamic_log_info =
+        makeDroppedRecordsReport(sink.num_dropped_, SINK_TOO_SLOW);
+    size_t log_id = dynamic_log_info->log_id_;
+
+    sink_preamble_.clear();
+    if (sink.format_ == OutputFormat::TEXT) {
+        sink_assembler_.loadLogInfo(&registered_info_.get(log_id),
+                                    dynamic_log_info, getStaticPrefix(log_id),
+                                    getProducerPrefix(producer_id));
+        assembleToString(sink_assembler_, sink_preamble_);
+    } else {
+        if (!writeSinkPreamble(index, log_id))
+            return false;
+        sink_preamble_.clear();
+        sink_binary_writer_.loadDynamicInfo(dynamic_log_info, producer_id);
+        assembleToString(sink_binary_writer_, sink_preamble_);
+    }
+    if (!appendToSink(index, sink_preamble_))
+        return false;
+    sink.num_dropped_ = 0;
+    return true;
+}
+
+void Logger::flushSink(size_t index, bool wait) {
+    if (sinks_[index].nbytes_ == 0)
+        return;
+    // 不等待时也先回收已经完成的写入。
+    if (sinks_[index].writing_ && !wait)
+        reapCompletions(false);
+    while (sinks_[index].writing_) {
+        if (!wait)
+            return;
+        reapCompletions(true);
+    }
+    // 完成的写入可能已经接着写出了缓冲区中的日志。
+    if (sinks_[index].nbytes_ == 0)
+        return;
+
+    Sink& sink = sinks_[index];
+    sink.writing_ = true;
+    sink.write_bytes_ = sink.nbytes_;
+    sink.written_bytes_ = 0;
+    sink.active_ ^= 1;
+    sink.nbytes_ = 0;
+
+    int ring_ret = submitSinkWrite(index);
+    if (ring_ret < 0) {
+        fprintf(stderr,
+                "An error occurs when Logger is writing to a sink, your log "
+                "message may be incomplete: %s\n",
+                strerror(-ring_ret));
+        sink.writing_ = false;
+    }
+}
+
+void Logger::flushSinks(bool wait) {
+    for (size_t index = 0; index < sinks_.size(); ++index)
+        flushSink(index, wait);
+}
+
+int Logger::submitSinkWrite(size_t index) {
+    Sink& sink = sinks_[index];
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr)
+        return -EBUSY;
+
+    // 附加输出总是追加写入，同一时间只有一个写入，不需要 IOSQE_IO_DRAIN。
+    const char* data =
+        sink.buffers_[sink.active_ ^ 1].get() + sink.written_bytes_;
+    io_uring_prep_write(sqe, sink.fd_, data,
+                        sink.write_bytes_ - sink.written_bytes_,
+                        static_cast<uint64_t>(-1));
+    io_uring_sqe_set_data64(sqe, SINK_WRITE_REQUEST + sink.id_);
+
+    int ret = io_uring_submit(&ring);
+    if (ret > 0)
+        num_sqes_ += ret;
     return ret;
 }
 
-int Logger::submitLog(size_t nbytes) {
-    if (nbytes == 0)
-        return 0;
+void Logger::handleSinkCompletion(uint64_t request, int res) {
+    int sink_id = static_cast<int>(request - SINK_WRITE_REQUEST);
+    for (size_t index = 0; index < sinks_.size(); ++index) {
+        Sink& sink = sinks_[index];
+        if (sink.id_ != sink_id)
+            continue;
+
+        // 没有写出任何内容时无法继续，同样视为错误。
+        if (res <= 0) {
+            fprintf(stderr,
+                    "An error occurs when Logger is writing to a sink, your "
+                    "log message may be incomplete: %s\n",
+                    res < 0 ? strerror(-res) : "nothing was written");
+        } else {
+            sink.written_bytes_ += res;
+            // 短写时继续写出剩余的内容。
+            if (sink.written_bytes_ < sink.write_bytes_ &&
+                submitSinkWrite(index) > 0)
+                return;
+        }
+        sink.writing_ = false;
+
+        // 写出期间积累的日志不必等到下一次 flushSinks。
+        flushSink(index, false);
+        return;
+    }
+}
+
+void Logger::collectDroppedRecords(buffers::StagingBuffer* buffer) {
+    uint64_t num_dropped = buffer->takeDroppedRecords();
+    if (num_dropped > 0)
+        dropped_records_.push_back(
+            DroppedRecords{buffer->getId(), num_dropped});
+}
+
+void Logger::reportDroppedRecords() {
+    for (const DroppedRecords& dropped : dropped_records_)
+        reportDroppedRecords(dropped.producer_id_, dropped.num_dropped_);
+    dropped_records_.clear();
+}
+
+void Logger::reportDroppedRecords(uint32_t producer_id, uint64_t num_dropped) {
+    writeLogRecord(makeDroppedRecordsReport(num_dropped, STAGING_BUFFER_FULL),
+                   producer_id);
+}
+
+const log_info::DynamicLogInfo* Logger::makeDroppedRecordsReport(
+    uint64_t num_dropped, const char* reason) {
+    if (dropped_records_log_id_.load(std::memory_order_relaxed) ==
+        log_info::UNREGISTERED_LOG_ID)
+        registerLogInfoInternal(dropped_records_log_id_,
+                                DROPPED_RECORDS_STATIC_INFO);
+
+    // 以生产者写入日志的方式构造动态信息。
+    size_t string_sizes[DROPPED_RECORDS_NUM_PARAMS + 1];
+    size_t pre_precision = 0;
+    size_t alloc_size =
+        log_info::GetArgSizes(DROPPED_RECORDS_PARAM_TYPES, string_sizes,
+                              pre_precision, num_dropped, reason) +
+        sizeof(log_info::DynamicLogInfo);
+    assert(alloc_size <= sizeof(dropped_records_report_));
+
+    log_info::DynamicLogInfo* dynamic_log_info =
+        new (dropped_records_report_) log_info::DynamicLogInfo();
+    dynamic_log_info->log_id_ =
+        dropped_records_log_id_.load(std::memory_order_relaxed);
+    dynamic_log_info->info_size_ = alloc_size;
+    dynamic_log_info->timestamp_ = utils::ReadTsc();
+    char* write_pos =
+        dropped_records_report_ + sizeof(log_info::DynamicLogInfo);
+    log_info::StoreArguments(write_pos, DROPPED_RECORDS_PARAM_TYPES,
+                             string_sizes, num_dropped, reason);
+    return dynamic_log_info;
+}
+
+void Logger::swapOutputBuffer(size_t nbytes, bool is_full) {
+    // 顺便回收已经写完的缓冲区，不等待。
+    reapCompletions(false);
+
+    if (nbytes == 0 && (carried_bytes_ == 0 || carried_block_written_))
+        return;
+
+    OutputBuffer& buffer = output_buffers_[log_buffer_idx_];
+    size_t total_bytes = carried_bytes_ + nbytes;
+    size_t write_bytes = total_bytes;
+
+    // O_DIRECT 只能写出完整的块。缓冲区已满时，末尾不完整的块留给
+    // 下一个缓冲区，写入之间不会重叠；否则以 0 填充后立即写出。
+    size_t tail_bytes =
+        output_direct_ ? total_bytes % config::DIRECT_IO_ALIGNMENT : 0;
+    if (tail_bytes > 0 && is_full) {
+        write_bytes -= tail_bytes;
+    } else if (tail_bytes > 0) {
+        size_t padding = config::DIRECT_IO_ALIGNMENT - tail_bytes;
+        memset(buffer.data_.get() + total_bytes, 0, padding);
+        write_bytes += padding;
+    }
+
+    buffer.nbytes_ = write_bytes;
+    buffer.written_bytes_ = 0;
+    buffer.fd_ = output_fd_;
+    buffer.offset_ = output_positioned_ ? output_offset_ - carried_bytes_ : -1;
+    buffer.drain_ = !output_positioned_ || carried_block_written_;
+
+    // 已满的缓冲区之后还有日志，最后一条日志可能只写出了一部分，
+    // 同步请求留到本轮最后一次写入。
+    if (durability_policy_.load(std::memory_order_relaxed) ==
+            DurabilityPolicy::PERIODIC &&
+        isPeriodicSyncDue())
+        sync_requested_ = true;
+    buffer.sync_ = sync_requested_ && !is_full;
+    buffer.framed_ = compressing_;
+
+    // 帧的长度在压缩完成后才知道，由日志线程按顺序取出并决定写入的位置。
+    if (compressing_) {
+        compression_worker_->submit(log_buffer_idx_, buffer.data_.get(),
+                                    write_bytes, buffer.frame_data_.get());
+        submitCompressedBuffers(false);
+    } else if (!writeOutputBuffer(log_buffer_idx_, nbytes)) {
+        return;
+    }
+
+    waitForFreeOutputBuffer();
+    size_t prev_buffer_idx = log_buffer_idx_;
+    log_buffer_idx_ = free_output_buffers_.back();
+    free_output_buffers_.pop_back();
+
+    // 末尾不完整的块复制到新缓冲区的开头，由下一次写入连同新日志写出。
+    carried_bytes_ = tail_bytes;
+    carried_block_written_ = tail_bytes > 0 && !is_full;
+    if (tail_bytes > 0)
+        memcpy(output_buffers_[log_buffer_idx_].data_.get(),
+               output_buffers_[prev_buffer_idx].data_.get() + total_bytes -
+                   tail_bytes,
+               tail_bytes);
+
+    rotateOutputFileIfNeeded(is_full);
+}
+
+void Logger::reapCompletions(bool wait) {
+    while (num_sqes_ > 0) {
+        io_uring_cqe* cqe = nullptr;
+        int ret = wait ? io_uring_wait_cqe(&ring, &cqe)
+                       : io_uring_peek_cqe(&ring, &cqe);
+        if (ret == -EAGAIN && !wait)
+            return;
+        if (ret < 0) {
+            fprintf(stderr,
+                    "An error occurs when Logger is waiting for io_uring, your "
+                    "log message may be incomplete: %s\n",
+                    strerror(-ret));
+            return;
+        }
+        // 之后的完成事件只在已经到达时处理。
+        wait = false;
+
+        uint64_t user_data = io_uring_cqe_get_data64(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        num_sqes_--;
+
+        // 预分配只是优化，失败（如文件系统不支持）时照常写入。
+        if (user_data == PREALLOCATION_REQUEST) {
+            preallocating_ = false;
+            if (res < 0)
+                preallocation_failed_ = true;
+            closeRetiringFileIfIdle();
+            continue;
+        }
+
+        if (user_data >= ROTATION_CLOSE_REQUEST &&
+            user_data <= ROTATION_RENAME_REQUEST) {
+            handleRotationCompletion(user_data, res);
+            continue;
+        }
+
+        // 其余的特殊请求都大于附加输出写入的 user_data。
+        if (user_data >= SINK_WRITE_REQUEST) {
+            handleSinkCompletion(user_data, res);
+            continue;
+        }
+
+        // 链接的写入失败或短写时 fdatasync 会被取消，之后重新同步。
+        // 管道等不支持同步的文件返回 EINVAL，忽略。
+        if (user_data == SYNC_REQUEST) {
+            if (res == -ECANCELED)
+                sync_requested_ = true;
+            else if (res < 0 && res != -EINVAL)
+                fprintf(stderr,
+                        "An error occurs when Logger is syncing the log file: "
+                        "%s\n",
+                        strerror(-res));
+            continue;
+        }
+
+        size_t buffer_idx = static_cast<size_t>(user_data);
+        OutputBuffer& buffer = output_buffers_[buffer_idx];
+        if (res < 0) {
+            // 写入操作本身的错误通过 cqe->res 返回。
+            fprintf(stderr,
+                    "An error occurs when Logger is writing, your log message "
+                    "may be incomplete: %s\n",
+                    strerror(-res));
+        } else {
+            buffer.written_bytes_ += res;
+            // 短写时继续写出剩余的内容。
+            if (res > 0 && buffer.written_bytes_ < buffer.nbytes_ &&
+                submitLog(buffer_idx) > 0)
+                continue;
+        }
+        free_output_buffers_.push_back(buffer_idx);
+        closeRetiringFileIfIdle();
+    }
+}
+
+void Logger::waitForAllWrites() {
+    while (compression_worker_ != nullptr &&
+           compression_worker_->hasPendingJobs())
+        submitCompressedBuffers(true);
+    flushSinks(true);
+    closeRetiringFileIfIdle();
+    while (num_sqes_ > 0)
+        reapCompletions(true);
+}
+
+void Logger::waitForFreeOutputBuffer() {
+    // 全部输出缓冲区都在写出或压缩时，等待其中一个完成。
+    // 没有进行中的写入时，压缩完成的缓冲区写出后才能被回收。
+    while (free_output_buffers_.empty()) {
+        if (compression_worker_ != nullptr)
+            submitCompressedBuffers(num_sqes_ == 0);
+        reapCompletions(true);
+    }
+}
+
+bool Logger::writeOutputBuffer(size_t buffer_idx, size_t nbytes) {
+    int ring_ret = submitLog(buffer_idx);
+    if (ring_ret < 0) {
+        fprintf(stderr,
+                "An error occurs when Logger is writing, your log message "
+                "may be incomplete: %s\n",
+                strerror(-ring_ret));
+        return false;
+    }
+
+    has_unsynced_writes_ = true;
+    output_file_size_ += nbytes;
+    if (output_positioned_) {
+        output_offset_ += nbytes;
+        preallocateOutputFile();
+    }
+    return true;
+}
+
+void Logger::submitCompressedBuffers(bool wait) {
+    size_t buffer_idx = 0;
+    size_t frame_size = 0;
+    while (compression_worker_->takeFinished(buffer_idx, frame_size, wait)) {
+        wait = false;
+
+        // 帧总是完整地写在上一个帧之后。
+        OutputBuffer& buffer = output_buffers_[buffer_idx];
+        buffer.nbytes_ = frame_size;
+        buffer.offset_ = output_positioned_ ? output_offset_ : -1;
+        buffer.drain_ = !output_positioned_;
+        if (!writeOutputBuffer(buffer_idx, frame_size))
+            free_output_buffers_.push_back(buffer_idx);
+    }
+}
+
+int Logger::submitLog(size_t buffer_idx) {
+    OutputBuffer& buffer = output_buffers_[buffer_idx];
     io_uring_sqe* sqe = io_uring_get_sqe(&ring);
-    io_uring_prep_write(sqe, output_fd_, buffer_for_io_.get(), nbytes, 0);
+    if (sqe == nullptr)
+        return -EBUSY;
+
+    // 链接的 fdatasync 必须紧跟在写入之后，取不到 sqe 时留到之后同步。
+    io_uring_sqe* sync_sqe = nullptr;
+    if (buffer.sync_)
+        sync_sqe = io_uring_get_sqe(&ring);
+    buffer.sync_ = false;
+
+    // 使用注册的文件和缓冲区时，内核不需要在每次提交时查找文件描述符
+    // 和固定缓冲区的内存页。轮转后原来文件的短写仍写入原来的文件。
+    int file_index = getRegisteredFileIndex(buffer.fd_);
+    int fd = file_index >= 0 ? file_index : buffer.fd_;
+    char* data = buffer.framed_ ? buffer.frame_data_.get() : buffer.data_.get();
+    data += buffer.written_bytes_;
+    size_t nbytes = buffer.nbytes_ - buffer.written_bytes_;
+
+    // 偏移量为 -1 时使用并更新文件的当前位置，以 O_APPEND 打开的文件
+    // 总是写在末尾，重定向到普通文件的标准输出也不会覆盖已有内容。
+    uint64_t offset = static_cast<uint64_t>(-1);
+    if (buffer.offset_ >= 0)
+        offset = buffer.offset_ + buffer.written_bytes_;
+    // 帧所在的内存没有注册。
+    if (buffers_registered_ && !buffer.framed_)
+        io_uring_prep_write_fixed(sqe, fd, data, nbytes, offset, buffer_idx);
+    else
+        io_uring_prep_write(sqe, fd, data, nbytes, offset);
+
+    // 同一文件的写入可能被内核并行执行，写在当前位置时 IOSQE_IO_DRAIN
+    // 使该写入在之前的写入全部完成后才开始，保证日志的顺序；
+    // 重写上一次写入的最后一个块时也要等它完成。
+    // 其他带偏移量的写入各自写在自己的位置，可以同时进行、以任意顺序完成。
+    // 链接 fdatasync 时也要等之前的写入完成，使其同步此前的全部日志。
+    unsigned int sqe_flags =
+        buffer.drain_ || sync_sqe != nullptr ? IOSQE_IO_DRAIN : 0;
+    if (sync_sqe != nullptr)
+        sqe_flags |= IOSQE_IO_LINK;
+    if (file_index >= 0)
+        sqe_flags |= IOSQE_FIXED_FILE;
+    io_uring_sqe_set_flags(sqe, sqe_flags);
+    io_uring_sqe_set_data64(sqe, buffer_idx);
+
+    // RWF_DSYNC 使写入完成时数据已经落盘，与 O_DSYNC 相同。
+    if (durability_policy_.load(std::memory_order_relaxed) ==
+        DurabilityPolicy::EVERY_WRITE)
+        sqe->rw_flags = RWF_DSYNC;
+
+    if (sync_sqe != nullptr)
+        prepareSync(sync_sqe, buffer.fd_, 0);
+
+    // io_uring_submit 成功时返回提交的 sqe 数量。
     int ret = io_uring_submit(&ring);
-    if (ret == 0)
-        num_sqes_++;
+    if (ret > 0)
+        num_sqes_ += ret;
     return ret;
 }
 
+void Logger::prepareSync(io_uring_sqe* sqe, int fd, unsigned int sqe_flags) {
+    int file_index = getRegisteredFileIndex(fd);
+    io_uring_prep_fsync(sqe, file_index >= 0 ? file_index : fd,
+                        IORING_FSYNC_DATASYNC);
+    if (file_index >= 0)
+        sqe_flags |= IOSQE_FIXED_FILE;
+    io_uring_sqe_set_flags(sqe, sqe_flags);
+    io_uring_sqe_set_data64(sqe, SYNC_REQUEST);
+
+    sync_requested_ = false;
+    has_unsynced_writes_ = false;
+    last_sync_tsc_ = utils::ReadTsc();
+}
+
+bool Logger::isPeriodicSyncDue() const {
+    const utils::TscCalibration& calibration = tsc_clock_.getCalibration();
+    uint64_t interval_ticks = static_cast<uint64_t>(
+        config::PERIODIC_SYNC_INTERVAL_NS / calibration.ns_per_tick_);
+    return utils::ReadTsc() - last_sync_tsc_ >= interval_ticks;
+}
+
+void Logger::syncOutputFileIfNeeded() {
+    if (!sync_requested_ &&
+        !(has_unsynced_writes_ &&
+          durability_policy_.load(std::memory_order_relaxed) ==
+              DurabilityPolicy::PERIODIC &&
+          isPeriodicSyncDue()))
+        return;
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr)
+        return;
+
+    // 不与写入链接时，等待之前提交的写入全部完成后再同步。
+    prepareSync(sqe, output_fd_, IOSQE_IO_DRAIN);
+    int ret = io_uring_submit(&ring);
+    if (ret > 0)
+        num_sqes_ += ret;
+}
+
+void Logger::wakeUpConsumer() {
+    // 多个生产者同时发现日志线程休眠时，只由其中一个进行系统调用。
+    if (consumer_parked_.exchange(0) != 0)
+        utils::FutexWake(consumer_parked_);
+}
+
+bool Logger::hasPendingRecords() {
+    std::lock_guard<std::mutex> producer_buffers_lock(producer_buffers_mtx_);
+    for (buffers::StagingBuffer* buffer : producer_buffers_) {
+        size_t peek_bytes = 0;
+        buffer->peek(&peek_bytes);
+        if (peek_bytes > 0)
+            return true;
+    }
+    return false;
+}
+
+void Logger::waitForRecords(uint32_t idle_rounds, bool has_delayed_records) {
+    if (idle_rounds < config::CONSUMER_IDLE_SPIN_ROUNDS) {
+        utils::CpuRelax();
+        return;
+    }
+
+    if (idle_rounds < config::CONSUMER_IDLE_SPIN_ROUNDS +
+                          config::CONSUMER_IDLE_YIELD_ROUNDS) {
+        std::this_thread::yield();
+        return;
+    }
+
+    /* 重排窗口中还有日志时，最多休眠到它们可以被写出。*/
+    int64_t timeout_ns = max_flush_latency_ns_.load(std::memory_order_relaxed);
+    if (has_delayed_records)
+        timeout_ns = std::min(timeout_ns, config::ORDERED_OUTPUT_WINDOW_NS);
+
+    /* 先设置标志再检查一次，在检查之前发布的日志不会等到超时才被处理。
+     * 重排窗口中的日志总是可见的，这时跳过检查，依靠超时醒来。
+     */
+    consumer_parked_.store(1);
+    if (!consumer_should_exit_.load() &&
+        (has_delayed_records || !hasPendingRecords()) &&
+        !(compression_worker_ != nullptr &&
+          compression_worker_->hasFinishedJobs()))
+        utils::FutexWait(consumer_parked_, 1, timeout_ns);
+    consumer_parked_.store(0, std::memory_order_relaxed);
+}
+
+void Logger::consumeInBufferOrder() {
+    /* 轮询各生产者的缓冲区，读取日志动态信息。*/
+    std::unique_lock<std::mutex> producer_buffers_lock(producer_buffers_mtx_);
+
+    for (size_t consuming_buffer_idx = 0;
+         consuming_buffer_idx < producer_buffers_.size();
+         ++consuming_buffer_idx) {
+        /* 处理 consuming_buffer_idx 指向的缓冲区。*/
+        buffers::StagingBuffer* consuming_buffer =
+            producer_buffers_[consuming_buffer_idx];
+
+        size_t peek_bytes = 0;
+        char* read_pos = consuming_buffer->peek(&peek_bytes);
+        if (peek_bytes > 0) {
+            /* 有日志可写时将日志恢复并写入缓冲区。*/
+            producer_buffers_lock.unlock();
+
+            /* 生产者在发布日志之前修改的设置，在这里一定可见。*/
+            applyOutputSettings();
+
+            size_t bytes_consumed = 0;
+            while (bytes_consumed < peek_bytes) {
+                log_info::DynamicLogInfo* dynamic_log_info =
+                    reinterpret_cast<log_info::DynamicLogInfo*>(read_pos);
+
+                writeLogRecord(dynamic_log_info, consuming_buffer->getId());
+
+                bytes_consumed += dynamic_log_info->info_size_;
+                read_pos += dynamic_log_info->info_size_;
+                consuming_buffer->consume(dynamic_log_info->info_size_);
+            }
+
+            collectDroppedRecords(consuming_buffer);
+            reportDroppedRecords();
+
+            producer_buffers_lock.lock();
+        } else {
+            /* 生产者可能在丢弃日志后就不再写入。*/
+            collectDroppedRecords(consuming_buffer);
+
+            /* 没有说明该缓冲区可能已经被生产者弃用（生产者线程退出），
+             * 检查它能否被释放。
+             */
+            if (consuming_buffer->shouldBeDestructed()) {
+                delete consuming_buffer;
+
+                producer_buffers_.erase(producer_buffers_.begin() +
+                                        consuming_buffer_idx);
+                if (!producer_buffers_.empty())
+                    --consuming_buffer_idx;
+            }
+        }
+    }
+
+    producer_buffers_lock.unlock();
+    reportDroppedRecords();
+}
+
+void Logger::consumeInTimestampOrder(bool flush_all) {
+    auto later = [](const OrderedCursor& lhs, const OrderedCursor& rhs) {
+        return lhs.timestamp_ > rhs.timestamp_;
+    };
+
+    /* 取出各生产者缓冲区中的第一条日志建堆，同时释放已被弃用的缓冲区。*/
+    ordered_heap_.clear();
+    {
+        std::lock_guard<std::mutex> producer_buffers_lock(
+            producer_buffers_mtx_);
+
+        for (size_t idx = 0; idx < producer_buffers_.size(); ++idx) {
+            buffers::StagingBuffer* buffer = producer_buffers_[idx];
+
+            /* 被丢弃的日志晚于缓冲区中已有的日志，不参与排序，
+             * 在释放锁之后直接报告。
+             */
+            collectDroppedRecords(buffer);
+
+            size_t peek_bytes = 0;
+            char* read_pos = buffer->peek(&peek_bytes);
+            if (peek_bytes > 0) {
+                ordered_heap_.push_back(OrderedCursor{
+                    reinterpret_cast<log_info::DynamicLogInfo*>(read_pos)
+                        ->timestamp_,
+                    buffer, read_pos, peek_bytes});
+            } else if (buffer->shouldBeDestructed()) {
+                delete buffer;
+                producer_buffers_.erase(producer_buffers_.begin() + idx);
+                --idx;
+            }
+        }
+    }
+    reportDroppedRecords();
+    std::make_heap(ordered_heap_.begin(), ordered_heap_.end(), later);
+
+    /* 生产者在发布日志之前修改的设置，在这里一定可见。*/
+    if (!ordered_heap_.empty())
+        applyOutputSettings();
+
+    /* 晚于该时间戳的日志留到之后处理，等待其他线程中可能更早的日志。
+     * 生产者缓冲区只会被日志线程释放，所以在锁外访问它们是安全的。
+     */
+    const utils::TscCalibration& calibration = tsc_clock_.getCalibration();
+    uint64_t window_ticks = static_cast<uint64_t>(
+        config::ORDERED_OUTPUT_WINDOW_NS / calibration.ns_per_tick_);
+    uint64_t deadline = utils::ReadTsc() - window_ticks;
+
+    while (!ordered_heap_.empty()) {
+        if (!flush_all &&
+            static_cast<int64_t>(ordered_heap_.front().timestamp_ -
+                                 deadline) > 0)
+            break;
+
+        std::pop_heap(ordered_heap_.begin(), ordered_heap_.end(), later);
+        OrderedCursor& top = ordered_heap_.back();
+
+        log_info::DynamicLogInfo* dynamic_log_info =
+            reinterpret_cast<log_info::DynamicLogInfo*>(top.read_pos_);
+        writeLogRecord(dynamic_log_info, top.buffer_->getId());
+
+        size_t info_size = dynamic_log_info->info_size_;
+        top.read_pos_ += info_size;
+        top.remaining_bytes_ -= info_size;
+        top.buffer_->consume(info_size);
+
+        /* peek 得到的数据处理完后再次 peek，数据可能在缓冲区开头继续。*/
+        if (top.remaining_bytes_ == 0)
+            top.read_pos_ = top.buffer_->peek(&top.remaining_bytes_);
+
+        if (top.remaining_bytes_ > 0) {
+            top.timestamp_ =
+                reinterpret_cast<log_info::DynamicLogInfo*>(top.read_pos_)
+                    ->timestamp_;
+            std::push_heap(ordered_heap_.begin(), ordered_heap_.end(), later);
+        } else {
+            ordered_heap_.pop_back();
+        }
+    }
+}
+
 void Logger::consumerThreadMain() {
-    log_info::LogAssembler log_assembler;
-    log_assembler.setBuffer(buffer_for_log_.get(), config::DOUBLE_BUFFER_SIZE);
+    resetAssemblerBuffer();
 
     /* 指示等待 io_uring 任务完成的标志。 */
     bool has_outstanding_operation = false;
 
+    /* 连续没有日志可写的轮数。 */
+    uint32_t idle_rounds = 0;
+
     /* 即使主线程指示日志线程应当退出，但当缓冲区中还存在数据时，
      * 日志线程应该在这些数据被处理后再退出。
      */
-    while (!consumer_should_exit_ || has_outstanding_operation) {
-        /* 轮询各生产者的缓冲区，读取日志动态信息。*/
-        {
-            std::unique_lock<std::mutex> producer_buffers_lock(
-                producer_buffers_mtx_);
-
-            for (size_t consuming_buffer_idx = 0;
-                 consuming_buffer_idx < producer_buffers_.size();
-                 ++consuming_buffer_idx) {
-                /* 处理 consuming_buffer_idx 指向的缓冲区。*/
-                buffers::StagingBuffer* consuming_buffer =
-                    producer_buffers_[consuming_buffer_idx];
-
-                size_t peek_bytes = 0;
-                char* read_pos = consuming_buffer->peek(&peek_bytes);
-                if (peek_bytes > 0) {
-                    /* 有日志可写时使用 log_assembler
-                     * 将日志恢复并写入缓冲区。*/
-                    producer_buffers_lock.unlock();
-
-                    size_t bytes_consumed = 0;
-                    while (bytes_consumed < peek_bytes) {
-                        log_info::DynamicLogInfo* dynamic_log_info =
-                            reinterpret_cast<log_info::DynamicLogInfo*>(
-                                read_pos);
-
-                        if (dynamic_log_info->log_id_ >=
-                            shadow_registered_info_.size()) {
-                            // 动态信息对应的静态信息并未被日志线程复制，手动更新副本。
-                            updateShadowRegisteredInfo();
-                        }
-
-                        log_info::StaticLogInfo* static_log_info =
-                            &shadow_registered_info_[dynamic_log_info->log_id_];
-
-                        // 装载对应的静态信息、动态信息和生产者编号。
-                        log_assembler.loadLogInfo(static_log_info,
-                                                  dynamic_log_info,
-                                                  consuming_buffer_idx);
-
-                        // 将日志恢复并写入缓冲区。
-                        while (log_assembler.hasRemainingData()) {
-                            size_t bytes_writed = log_assembler.write();
-                            if (log_assembler.isBufferFull()) {
-                                swapDoubleBuffer(
-                                    log_assembler.getWritedBytes());
-                                log_assembler.setBuffer(
-                                    buffer_for_log_.get(),
-                                    config::DOUBLE_BUFFER_SIZE);
-                            }
-                        }
-
-                        bytes_consumed += dynamic_log_info->info_size_;
-                        read_pos += dynamic_log_info->info_size_;
-                        consuming_buffer->consume(dynamic_log_info->info_size_);
-                    }
-
-                    producer_buffers_lock.lock();
-                } else {
-                    /* 没有说明该缓冲区可能已经被生产者弃用（生产者线程退出），
-                     * 检查它能否被释放。
-                     */
-                    if (consuming_buffer->shouldBeDestructed()) {
-                        delete consuming_buffer;
-
-                        producer_buffers_.erase(producer_buffers_.begin() +
-                                                consuming_buffer_idx);
-                        if (!producer_buffers_.empty())
-                            --consuming_buffer_idx;
-                    }
-                }
-            }
-        }
+    while (true) {
+        bool should_exit = consumer_should_exit_.load();
+
+        applyOutputSettings();
+        updateTscCalibration();
+
+        /* 退出前写出重排窗口中剩余的全部日志。*/
+        bool is_ordered = ordered_output_.load(std::memory_order_relaxed);
+        if (is_ordered)
+            consumeInTimestampOrder(should_exit);
+        else
+            consumeInBufferOrder();
 
         has_outstanding_operation = false;
-        if (log_assembler.getWritedBytes() == 0) {
-            /* 暂时没有日志可写。 */
+        if (!hasUnsubmittedOutput()) {
+            /* 暂时没有日志可写，写出压缩完成的缓冲区，
+             * 顺便按持久化方式同步输出文件。
+             */
+            if (compression_worker_ != nullptr)
+                submitCompressedBuffers(false);
+            syncOutputFileIfNeeded();
+
+            /* 休眠之前写出附加输出中的日志。附加输出正在写出时不等待，
+             * 剩余的日志在那次写入完成时写出，慢的附加输出不会阻塞日志线程。
+             */
+            flushSinks(false);
         } else {
             /* 更换缓冲区。 */
-            swapDoubleBuffer(log_assembler.getWritedBytes());
-            log_assembler.setBuffer(buffer_for_log_.get(),
-                                    config::DOUBLE_BUFFER_SIZE);
+            swapOutputBuffer(getWritedBytes(), false);
+            resetAssemblerBuffer();
+            flushSinks(false);
             has_outstanding_operation = true;
         }
+
+        if (should_exit && !has_outstanding_operation)
+            break;
+
+        if (has_outstanding_operation) {
+            idle_rounds = 0;
+        } else {
+            waitForRecords(idle_rounds, is_ordered && !ordered_heap_.empty());
+            if (idle_rounds < UINT32_MAX)
+                ++idle_rounds;
+        }
     }
+
+    /* 退出前等待全部写入完成。*/
+    waitForAllWrites();
 }
 
 }  // namespace logger
@@ -3,13 +3,20 @@
 
 #include <liburing.h>
 
+#include <atomic>
+#include <cstdlib>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "binary_log.h"
 #include "buffers.h"
+#include "compression.h"
 #include "log_info.h"
 #include "olog_config.h"
+#include "registry.h"
+#include "utils.h"
 
 namespace olog {
 
@@ -19,6 +26,127 @@ namespace olog {
  */
 namespace logger {
 
+/**
+ * @brief
+ * 日志文件的输出格式。
+ */
+enum class OutputFormat : uint8_t {
+    // 由日志线程格式化后的文本。
+    TEXT = 0,
+
+    // 原样写出的日志动态信息和静态信息，需要使用 olog_decompress 恢复为文本。
+    BINARY
+};
+
+/**
+ * @brief
+ * 生产者的缓冲区空间不足时对新日志的处理方式。
+ */
+enum class OverflowPolicy : uint8_t {
+    // 自旋等待日志线程腾出空间。
+    BLOCK = 0,
+
+    // 直接丢弃新日志，生产者不会因日志而等待。
+    DROP,
+
+    // 丢弃新日志并计数，由日志线程写出一条说明丢弃数量的日志。
+    DROP_AND_COUNT
+};
+
+/**
+ * @brief
+ * 写入日志文件的方式。
+ */
+enum class WriteMode : uint8_t {
+    // 以 O_APPEND 打开日志文件，写入依次追加到文件末尾。
+    APPEND = 0,
+
+    // 由日志线程维护文件偏移量，以带偏移量的写入写到各自的位置，
+    // 多个写入可以同时进行并以任意顺序完成。日志线程会为文件分段预分配空间。
+    // 文件不应同时被其他进程写入。
+    POSITIONED,
+
+    // 在 POSITIONED 的基础上以 O_DIRECT 打开文件，日志不经过页缓存。
+    // 写出时末尾不完整的块以 0 填充，之后的写入会连同新日志重写该块，
+    // 关闭文件时去掉填充；程序异常退出时文件末尾可能残留填充。
+    // 文件系统不支持 O_DIRECT 时退回 POSITIONED。
+    DIRECT
+};
+
+/**
+ * @brief
+ * 日志写入文件后的持久化方式。
+ */
+enum class DurabilityPolicy : uint8_t {
+    // 不主动同步，由操作系统决定何时写回磁盘。
+    NONE = 0,
+
+    // 距上次同步超过 config::PERIODIC_SYNC_INTERVAL_NS 后执行一次 fdatasync。
+    PERIODIC,
+
+    // 写出 ERROR 等级的日志后立即执行一次 fdatasync。
+    ON_ERROR,
+
+    // 每次写入都以 RWF_DSYNC 写出，与以 O_DSYNC 打开文件相同。
+    EVERY_WRITE
+};
+
+/**
+ * @brief
+ * OLOG 调用点在运行时的开关状态，由 Logger::EnableLogSites 等设置。
+ */
+enum class LogSiteState : uint8_t {
+    // 调用点尚未执行过，还没有向 Logger 登记。
+    UNREGISTERED = 0,
+
+    // 按日志等级决定是否输出。
+    BY_LEVEL,
+
+    // 不论日志等级总是输出。
+    ENABLED,
+
+    // 不论日志等级总是忽略。
+    DISABLED
+};
+
+/**
+ * @brief
+ * 链接时收集的调用点条目。OLOG 调用点以汇编直接向 olog_static_info
+ * 段写入该结构，Logger 构造时遍历该段为每个调用点分配 log_id 并登记调用点。
+ * 内联函数和模板中的调用点在每个使用它的目标文件中都有一个条目，
+ * 这些条目指向同一个静态信息、log_id 和调用点状态。
+ */
+struct StaticInfoEntry {
+    const log_info::StaticLogInfo* static_info_;
+
+    std::atomic<int>* log_id_;
+
+    std::atomic<LogSiteState>* site_state_;
+};
+
+static_assert(sizeof(StaticInfoEntry) == 3 * sizeof(void*),
+              "StaticInfoEntry must match the entries emitted by OLOG");
+
+/**
+ * 当前允许输出的最高日志等级，比该等级高的日志会被忽略。
+ * 放在 Logger 之外，OLOG 检查等级时只需一次 relaxed 读取，
+ * 不经过 Logger::GetInstance 中局部静态变量的初始化检查。
+ * 由 Logger::SetLogLevel 修改。
+ */
+inline std::atomic<uint8_t> current_log_level{
+    static_cast<uint8_t>(log_info::LogLevel::INFO)};
+
+/**
+ * @brief
+ * 检查该等级的日志是否允许输出。
+ *
+ * @param severity 日志等级。
+ */
+inline bool IsLogLevelEnabled(log_info::LogLevel severity) {
+    return static_cast<uint8_t>(severity) <=
+           current_log_level.load(std::memory_order_relaxed);
+}
+
 class Logger {
   public:
     /**
@@ -33,26 +161,103 @@ class Logger {
      * @brief
      * 向 Logger 单例注册日志。
      * Logger 单例会保存日志静态信息方便复用。
+     * 支持链接时注册时调用点已在构造 Logger 时注册，
+     * 这里只用于其他平台以及没有链接时注册的模块中的调用点。
      *
      * @param static_log_info 被注册的日志静态信息。
      * @param log_id 对注册 id 的引用。
      */
-    static inline void RegisterLogInfo(log_info::StaticLogInfo static_log_info,
-                                       int& log_id) {
+    static inline void RegisterLogInfo(
+        const log_info::StaticLogInfo& static_log_info,
+        std::atomic<int>& log_id) {
         GetInstance().registerLogInfoInternal(log_id, static_log_info);
     }
 
+    /**
+     * @brief
+     * OLOG 调用点第一次执行时登记调用点，按已有的规则设置它的状态。
+     * 支持链接时注册时调用点已在构造 Logger 时登记，
+     * 这里只用于其他平台以及没有链接时注册的模块中的调用点。
+     *
+     * @param state 调用点的状态，与 log_id 一样静态存储。
+     * @param filename 调用点所在的文件。
+     * @param line_number 调用点所在的行。
+     * @param format 调用点的格式串。
+     * @return 调用点的状态。
+     */
+    static inline LogSiteState RegisterLogSite(
+        std::atomic<LogSiteState>& state, const char* filename,
+        int line_number, const char* format) {
+        return GetInstance().registerLogSiteInternal(state, filename,
+                                                     line_number, format);
+    }
+
+    /**
+     * @brief
+     * 不论日志等级，开启匹配的调用点，例如在生产环境中只开启
+     * 一个模块的 DEBUG 日志。规则对之后才执行到的调用点同样有效，
+     * 后设置的规则优先。
+     *
+     * @param file_glob 匹配调用点文件名（即 __FILE__）的通配符，
+     * 如 "*net/socket.cc"，为 nullptr 时匹配全部文件。
+     * @param line_number 调用点所在的行，为 0 时匹配全部行。
+     * @param format_substring 格式串中包含的子串，为 nullptr 时不检查。
+     * @return 已经登记的调用点中匹配的数量，支持链接时注册时
+     * 包括尚未执行的调用点。
+     */
+    static inline size_t EnableLogSites(
+        const char* file_glob, int line_number = 0,
+        const char* format_substring = nullptr) {
+        return GetInstance().addLogSiteRule(file_glob, line_number,
+                                            format_substring,
+                                            LogSiteState::ENABLED);
+    }
+
+    /**
+     * @brief
+     * 不论日志等级，关闭匹配的调用点。参数同 EnableLogSites。
+     *
+     * @return 已经登记的调用点中匹配的数量。
+     */
+    static inline size_t DisableLogSites(
+        const char* file_glob, int line_number = 0,
+        const char* format_substring = nullptr) {
+        return GetInstance().addLogSiteRule(file_glob, line_number,
+                                            format_substring,
+                                            LogSiteState::DISABLED);
+    }
+
+    /**
+     * @brief
+     * 清除 EnableLogSites 和 DisableLogSites 设置的全部规则，
+     * 全部调用点重新按日志等级决定是否输出。
+     */
+    static inline void ResetLogSites() {
+        GetInstance().resetLogSitesInternal();
+    }
+
     /**
      * @brief
      * 在缓冲区中预留指定大小的字节。
      *
      * @param num_bytes 要分配的字节数。
-     * @return 写入位置。
+     * @return 写入位置。空间不足且按 OverflowPolicy 丢弃日志时返回 nullptr。
      */
     static inline char* ReserveAlloc(size_t num_bytes) {
         if (staging_buffer_ == nullptr)
             GetInstance().ensureBufferIsAllocated();
-        return staging_buffer_->reserveProducerSpace(num_bytes);
+
+        // 经由缓存的 Logger 读取，不经过 GetInstance 中局部静态变量的检查。
+        OverflowPolicy policy =
+            thread_logger_->overflow_policy_.load(std::memory_order_relaxed);
+        if (policy == OverflowPolicy::BLOCK)
+            return staging_buffer_->reserveProducerSpace(num_bytes);
+
+        char* write_pos =
+            staging_buffer_->reserveProducerSpace(num_bytes, false);
+        if (write_pos == nullptr && policy == OverflowPolicy::DROP_AND_COUNT)
+            staging_buffer_->addDroppedRecord();
+        return write_pos;
     }
 
     /**
@@ -63,6 +268,12 @@ class Logger {
      */
     static inline void FinishAlloc(size_t num_bytes) {
         staging_buffer_->finishReservation(num_bytes);
+
+        // 只有日志线程休眠时才需要唤醒它，通常只是一次读取。
+        // 不使用内存屏障，丢失的唤醒由 SetMaxFlushLatency 的超时兜底。
+        if (thread_logger_->consumer_parked_.load(std::memory_order_relaxed) !=
+            0)
+            thread_logger_->wakeUpConsumer();
     }
 
     /**
@@ -82,7 +293,8 @@ class Logger {
      * @return 允许输出的最高日志等级。
      */
     static inline log_info::LogLevel GetLogLevel() {
-        return GetInstance().getLogLevelInternal();
+        return static_cast<log_info::LogLevel>(
+            current_log_level.load(std::memory_order_relaxed));
     }
 
     /**
@@ -95,6 +307,243 @@ class Logger {
         GetInstance().setLogFileInternal(filename);
     }
 
+    /**
+     * @brief
+     * 设置日志文件的输出格式。
+     * 同一个文件中不应混杂两种格式，所以应当在 SetLogFile 前后立即调用。
+     *
+     * @param format 输出格式。
+     */
+    static inline void SetOutputFormat(OutputFormat format) {
+        GetInstance().output_format_.store(format, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 获取日志文件的输出格式。
+     *
+     * @return OutputFormat
+     */
+    static inline OutputFormat GetOutputFormat() {
+        return GetInstance().output_format_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置文本日志中时间戳的精度，默认为毫秒。
+     *
+     * @param precision 时间戳精度。
+     */
+    static inline void SetTimestampPrecision(
+        log_info::TimestampPrecision precision) {
+        GetInstance().timestamp_precision_.store(precision,
+                                                 std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 获取文本日志中时间戳的精度。
+     *
+     * @return log_info::TimestampPrecision
+     */
+    static inline log_info::TimestampPrecision GetTimestampPrecision() {
+        return GetInstance().timestamp_precision_.load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置是否按时间戳顺序输出各个线程的日志。
+     * 开启后日志线程会归并各生产者缓冲区头部的日志，一条日志在产生
+     * config::ORDERED_OUTPUT_WINDOW_NS 纳秒后才会被写出，
+     * 晚于该时间才被提交的日志仍可能乱序。默认关闭。
+     *
+     * @param enabled
+     */
+    static inline void SetOrderedOutput(bool enabled) {
+        GetInstance().ordered_output_.store(enabled,
+                                            std::memory_order_relaxed);
+    }
+
+    static inline bool IsOrderedOutput() {
+        return GetInstance().ordered_output_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置生产者缓冲区空间不足时对新日志的处理方式，默认为阻塞。
+     * DROP_AND_COUNT 下被丢弃的数量会在日志线程下次访问该缓冲区时
+     * 以一条 WARNING 日志写出。
+     *
+     * @param policy
+     */
+    static inline void SetOverflowPolicy(OverflowPolicy policy) {
+        GetInstance().overflow_policy_.store(policy,
+                                             std::memory_order_relaxed);
+    }
+
+    static inline OverflowPolicy GetOverflowPolicy() {
+        return GetInstance().overflow_policy_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置最大写出延迟，即日志线程空闲时一次休眠的最长时间，
+     * 默认为 config::DEFAULT_MAX_FLUSH_LATENCY_NS。
+     * 生产者只在日志线程休眠时唤醒它，且不使用内存屏障，
+     * 因此极少数情况下唤醒会丢失，日志最多在该时间之后被写出。
+     *
+     * @param latency_ns 最大写出延迟（纳秒）。
+     */
+    static inline void SetMaxFlushLatency(int64_t latency_ns) {
+        GetInstance().max_flush_latency_ns_.store(latency_ns,
+                                                  std::memory_order_relaxed);
+    }
+
+    static inline int64_t GetMaxFlushLatency() {
+        return GetInstance().max_flush_latency_ns_.load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置写入日志文件的方式，默认为 APPEND。
+     * 只对之后由 SetLogFile 打开的文件生效，标准输出总是追加写入。
+     *
+     * @param mode
+     */
+    static inline void SetWriteMode(WriteMode mode) {
+        GetInstance().write_mode_.store(mode, std::memory_order_relaxed);
+    }
+
+    static inline WriteMode GetWriteMode() {
+        return GetInstance().write_mode_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置日志写入文件后的持久化方式，默认为 EVERY_WRITE。
+     * fdatasync 在之前提交的写入全部完成后才执行，
+     * 会同步此前写出的全部日志。
+     *
+     * @param policy
+     */
+    static inline void SetDurabilityPolicy(DurabilityPolicy policy) {
+        GetInstance().durability_policy_.store(policy,
+                                               std::memory_order_relaxed);
+    }
+
+    static inline DurabilityPolicy GetDurabilityPolicy() {
+        return GetInstance().durability_policy_.load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置按大小轮转日志文件的阈值，默认为 0，即不按大小轮转。
+     * 日志文件达到该大小后，日志线程将其重命名为带有时间的归档文件
+     * （如 app.log.20240101-120000-000），并在原来的文件名上继续写入。
+     * 只对由 SetLogFile 打开的普通文件有效。
+     *
+     * @param max_bytes 日志文件大小的上限（字节）。
+     */
+    static inline void SetRotationSize(uint64_t max_bytes) {
+        GetInstance().rotation_size_.store(max_bytes,
+                                           std::memory_order_relaxed);
+    }
+
+    static inline uint64_t GetRotationSize() {
+        return GetInstance().rotation_size_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置按时间轮转日志文件的间隔，默认为 0，即不按时间轮转。
+     * 只在写出日志时检查，日志文件打开超过该时间后轮转。
+     *
+     * @param interval_ns 轮转的间隔（纳秒）。
+     */
+    static inline void SetRotationInterval(int64_t interval_ns) {
+        GetInstance().rotation_interval_ns_.store(interval_ns,
+                                                  std::memory_order_relaxed);
+    }
+
+    static inline int64_t GetRotationInterval() {
+        return GetInstance().rotation_interval_ns_.load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 设置压缩输出的压缩器，默认为 nullptr，即不压缩。
+     * 设置后每个输出缓冲区都由压缩线程压缩为一个帧再写出，
+     * 日志线程不等待压缩，需要使用 olog_decompress 恢复。
+     * 同一个文件中不应混杂压缩和未压缩的内容，所以应当在 SetLogFile
+     * 前后立即调用。压缩后的帧长度不定，以 WriteMode::DIRECT 写入时
+     * 退回 POSITIONED。
+     *
+     * @param compressor 压缩器，为 nullptr 时不再压缩。
+     */
+    static inline void SetCompressor(
+        std::unique_ptr<compression::Compressor> compressor) {
+        GetInstance().setCompressorInternal(std::move(compressor));
+    }
+
+    static inline bool IsCompressionEnabled() {
+        return GetInstance().compression_enabled_.load(
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 在日志文件之外添加一个附加输出，例如将 WARNING 及以上的日志
+     * 另外写到一个文件中。每个附加输出有自己的等级、格式和缓冲区，
+     * 由日志线程通过 io_uring 追加写入，不进行轮转、压缩和同步。
+     * 格式相同的输出共享同一次格式化的结果。
+     * SetLogLevel 设置的等级对全部输出生效。
+     *
+     * @param filename 文件名。
+     * @param max_level 写入该输出的最高日志等级。
+     * @param format 输出格式。
+     * @return 附加输出的编号，用于 RemoveSink。
+     *
+     * @throw std::ios_base::failure 无法打开文件。
+     * @throw std::length_error 附加输出已经达到 config::MAX_SINKS 个。
+     */
+    static inline int AddSink(const char* filename,
+                              log_info::LogLevel max_level,
+                              OutputFormat format = OutputFormat::TEXT) {
+        return GetInstance().addSinkInternal(filename, max_level, format);
+    }
+
+    /**
+     * @brief
+     * 添加写入已打开的文件描述符（如 STDERR_FILENO）的附加输出，
+     * 由调用者负责关闭，移除之前应当保持打开。
+     *
+     * @param fd 文件描述符。
+     * @param max_level 写入该输出的最高日志等级。
+     * @param format 输出格式。
+     * @return 附加输出的编号，用于 RemoveSink。
+     *
+     * @throw std::length_error 附加输出已经达到 config::MAX_SINKS 个。
+     */
+    static inline int AddSink(int fd, log_info::LogLevel max_level,
+                              OutputFormat format = OutputFormat::TEXT) {
+        return GetInstance().addSinkInternal(fd, false, max_level, format);
+    }
+
+    /**
+     * @brief
+     * 移除附加输出。在此之前提交的日志仍会写入该输出，
+     * 由 AddSink 打开的文件在写入完成后关闭。
+     *
+     * @param sink_id AddSink 返回的编号。
+     */
+    static inline void RemoveSink(int sink_id) {
+        GetInstance().removeSinkInternal(sink_id);
+    }
+
   private:
     Logger();
 
@@ -118,6 +567,7 @@ class Logger {
 
             // new 一个新的 StagingBuffer 不需要加锁。
             lock.unlock();
+            thread_logger_ = this;
             staging_buffer_ = new buffers::StagingBuffer{
                 buffer_id, config::STORAGE_BUFFER_SIZE,
                 staging_buffer_destruct_guard_};
@@ -130,13 +580,23 @@ class Logger {
 
     /**
      * @brief
-     * RegisterLogInfo 的内部方法，
+     * 遍历 olog_static_info 段，为链接时收集的调用点分配 log_id
+     * 并登记调用点，规则因此可以作用于尚未执行过的调用点。
+     * 在构造时调用，早于任何日志写入。
+     */
+    void registerLinkTimeLogInfo();
+
+    /**
+     * @brief
+     * RegisterLogInfo 的内部方法。不加锁，多个线程同时第一次执行同一调用点时
+     * 先以 RESERVED_LOG_ID 占用 log_id 的线程注册，其余线程等待它分配的 id。
      *
      * @param log_id 对注册 id 的引用。
      * @param static_log_info 被注册的日志静态信息。
      */
-    void registerLogInfoInternal(int& log_id,
-                                 log_info::StaticLogInfo static_log_info);
+    void registerLogInfoInternal(
+        std::atomic<int>& log_id,
+        const log_info::StaticLogInfo& static_log_info);
 
     /**
      * @brief
@@ -148,17 +608,45 @@ class Logger {
 
     /**
      * @brief
-     * 获取当前允许输出的最高日志等级。
+     * RegisterLogSite 的内部方法。
+     */
+    LogSiteState registerLogSiteInternal(std::atomic<LogSiteState>& state,
+                                         const char* filename, int line_number,
+                                         const char* format);
+
+    /**
+     * @brief
+     * 登记一个尚未登记的调用点，按已有的规则设置它的状态。
+     * 调用者需持有 log_sites_mtx_。
      *
-     * @return log_info::LogLevel
+     * @return 调用点的状态。
      */
-    inline log_info::LogLevel getLogLevelInternal() const {
-        return current_log_level_;
-    }
+    LogSiteState addLogSite(std::atomic<LogSiteState>& state,
+                            const char* filename, int line_number,
+                            const char* format);
+
+    /**
+     * @brief
+     * 添加一条调用点规则，并应用到已经登记的调用点。
+     *
+     * @param file_glob 为 nullptr 时匹配全部文件。
+     * @param line_number 为 0 时匹配全部行。
+     * @param format_substring 为 nullptr 时不检查格式串。
+     * @param state 匹配的调用点的状态。
+     * @return 已经登记的调用点中匹配的数量。
+     */
+    size_t addLogSiteRule(const char* file_glob, int line_number,
+                          const char* format_substring, LogSiteState state);
+
+    /**
+     * @brief
+     * ResetLogSites 的内部方法。
+     */
+    void resetLogSitesInternal();
 
     /**
      * @brief
-     * 设置日志输出文件。
+     * 打开日志输出文件，交由日志线程替换当前的输出文件。
      *
      * @param filename 文件名。
      *
@@ -168,111 +656,1009 @@ class Logger {
 
     /**
      * @brief
-     * 从 registered_info_ 中复制未复制的内容到 shadow_registered_info_。
+     * 交由日志线程更换压缩器。
+     *
+     * @param compressor
      */
-    void updateShadowRegisteredInfo();
+    void setCompressorInternal(
+        std::unique_ptr<compression::Compressor> compressor);
 
     /**
      * @brief
-     * 将 buffer_for_log_ 和 buffer_for_io_ 的内容交换。
-     * 将日志线程使用的缓冲区和 io_uring 要写出的缓冲区交换。
+     * 打开文件并添加附加输出。
      *
-     * @param bytes_in_buffer_for_log buffer_for_log_ 中写入的字节数
+     * @param filename 文件名。
+     * @param max_level 写入该输出的最高日志等级。
+     * @param format 输出格式。
+     * @return 附加输出的编号。
+     *
+     * @throw std::ios_base::failure 无法打开文件。
+     * @throw std::length_error 附加输出已经达到 config::MAX_SINKS 个。
      */
-    inline void swapDoubleBuffer(size_t bytes_in_buffer_for_log) {
-        int ring_ret = waitForIoUring();
-        if (ring_ret < 0)
-            fprintf(stderr,
-                    "An error occurs when Logger is waiting for io_uring, your "
-                    "log message may be incomplete: %s\n",
-                    strerror(-ring_ret));
-        buffer_for_io_.swap(buffer_for_log_);
-        ring_ret = submitLog(bytes_in_buffer_for_log);
-        if (ring_ret < 0)
-            fprintf(stderr,
-                    "An error occurs when Logger is writing, your log message "
-                    "may be incomplete: %s\n",
-                    strerror(-ring_ret));
-    }
+    int addSinkInternal(const char* filename, log_info::LogLevel max_level,
+                        OutputFormat format);
 
     /**
-     * @brief 等待 io_uring 完成。
+     * @brief
+     * 交由日志线程添加写入 fd 的附加输出。
      *
-     * @return io_uring_wait_cqe 的返回值。
+     * @param fd 文件描述符。
+     * @param owns_fd 移除附加输出时是否关闭 fd。
+     * @param max_level 写入该输出的最高日志等级。
+     * @param format 输出格式。
+     * @return 附加输出的编号。
+     *
+     * @throw std::length_error 附加输出已经达到 config::MAX_SINKS 个。
      */
-    int waitForIoUring();
+    int addSinkInternal(int fd, bool owns_fd, log_info::LogLevel max_level,
+                        OutputFormat format);
 
     /**
      * @brief
-     * 提交 buffer_for_io_ 到 io_uring，将内容写到 output_fd_ 对应的文件中。
+     * 交由日志线程移除附加输出。
      *
-     * @param nbytes 缓冲区中数据的大小。
-     * @return io_uring_submit 的返回值。
+     * @param sink_id
      */
-    int submitLog(size_t nbytes);
+    void removeSinkInternal(int sink_id);
 
     /**
      * @brief
-     * 日志线程的主函数。
-     * 后台线程从各个工作线程（生产者）的 staging_buffer_
-     * 中读出日志的动态信息，并与其对应的日志静态信息进行处理，
-     * 写入 Logger 中指定的文件。
+     * 由日志线程调用，添加和移除附加输出。
+     * 被移除的输出在写入全部完成后关闭。
      */
-    void consumerThreadMain();
-
-  private:
-    // 当前允许输出的最高日志等级，比该等级高的日志会被忽略。
-    log_info::LogLevel current_log_level_;
+    void applySinkChanges();
 
-    // 日志输出文件的格式描述符。
-    int output_fd_;
+    /**
+     * @brief
+     * 由日志线程调用，应用新的输出文件、输出格式和时间戳精度。
+     * 在此之前缓冲区中的日志会被写入原来的文件。
+     */
+    void applyOutputSettings();
 
-    // io_uring 的数据结构。
-    io_uring ring;
+    /**
+     * @brief
+     * 初始化 io_uring。
+     *
+     * @param use_sqpoll 是否使用 SQPOLL 模式，参数见 config::IO_URING_SQPOLL。
+     * @return io_uring_queue_init_params 的返回值。SQPOLL 模式不支持
+     * 普通文件描述符时返回 -EOPNOTSUPP，io_uring 不会被初始化。
+     */
+    int initIoUring(bool use_sqpoll);
 
-    // 提交到 sq 上的 sqe 数量。
-    unsigned int num_sqes_;
+    /**
+     * @brief
+     * 向 io_uring 注册输出缓冲区和输出文件。
+     * 内核或资源限制不允许注册时，退回使用普通的缓冲区和文件描述符。
+     */
+    void registerIoResources();
 
-    // 对 registered_info_ 进行保护。
-    std::mutex registered_info_mtx_;
+    /**
+     * @brief
+     * 换上新的输出文件后调用。输出文件是没有以 O_APPEND 打开的普通文件时，
+     * 从文件末尾开始以带偏移量的写入写出日志。
+     * 以 O_DIRECT 打开时，将文件末尾不完整的块读入日志线程正在使用的
+     * 输出缓冲区，以便连同新日志一起重写。
+     */
+    void initOutputOffset();
 
-    // 存储已注册的日志的静态信息。日志线程会复用这些信息。
-    // 生产者会对该属性进行写操作，而日志线程（消费者）会
-    // 对其进行读操作，该属性需要用锁控制的正确性。
-    std::vector<log_info::StaticLogInfo> registered_info_;
+    /**
+     * @brief
+     * 需要时为输出文件提交下一段预分配，使之后的写入落在已分配的空间中。
+     */
+    void preallocateOutputFile();
 
-    // registered_info_ 内容的副本。
-    // 日志线程需要大量访问静态日志信息，加之注册期间 vector
-    // 可能会发生扩容，所以这里使用副本仅供日志线程使用。
-    std::vector<log_info::StaticLogInfo> shadow_registered_info_;
+    /**
+     * @brief
+     * 关闭输出文件前调用，将文件截断到日志的实际长度，
+     * 释放未使用的预分配空间并去掉 O_DIRECT 写入的填充。
+     * 调用前全部写入都应已完成。
+     */
+    void trimOutputFile();
 
-    // 为每个线程都分配一个单独的缓冲区，用于传输日志的动态信息。
-    static thread_local buffers::StagingBuffer* staging_buffer_;
+    /**
+     * @brief
+     * 写出输出缓冲区后调用。日志文件达到轮转的大小或时间时，
+     * 通过 io_uring 提交重命名和打开新文件的请求；新文件已经打开时，
+     * 在日志之间的缓冲区边界换上新文件。日志线程不等待这些文件操作，
+     * 也不等待原来文件的写入。
+     *
+     * @param is_full 写出的缓冲区是否已满。已满的缓冲区之后还有日志，
+     * 最后一条日志可能只写出了一部分，这时不更换文件。
+     */
+    void rotateOutputFileIfNeeded(bool is_full);
 
-    // 通知日志线程析构相应线程的缓冲区。
-    static thread_local buffers::StagingBuffer::DestructGuard
-        staging_buffer_destruct_guard_;
+    /**
+     * @brief
+     * 提交链接的 renameat 和 openat，将日志文件重命名为归档文件，
+     * 并在原来的文件名上创建新文件。
+     */
+    void submitRotation();
 
-    // 对 producer_buffers_ 和 next_buffer_id_ 进行保护。
-    std::mutex producer_buffers_mtx_;
+    /**
+     * @brief
+     * 换上已经打开的新文件，之后的日志写入新文件。
+     * 原来文件的写入照常完成，之后由 closeRetiringFileIfIdle 关闭。
+     */
+    void switchToRotatedFile();
 
-    // 存储所有生产者的 StagingBuffer。
-    std::vector<buffers::StagingBuffer*> producer_buffers_;
+    /**
+     * @brief
+     * 轮转换下的文件上没有进行中的请求时，将其关闭。
+     * 在回收写入的完成事件和写出输出缓冲区后调用。
+     */
+    void closeRetiringFileIfIdle();
+
+    /**
+     * @brief
+     * 通过 io_uring 截断并关闭轮转换下的文件。
+     *
+     * @param trim 是否需要先将文件截断到日志的实际长度，参见 trimOutputFile。
+     * 内核不支持通过 io_uring 截断时不截断，日志线程不直接截断文件。
+     */
+    void closeRetiringFile(bool trim);
+
+    /**
+     * @brief
+     * 获取文件在注册的文件表中的下标。
+     *
+     * @param fd 输出文件或轮转换下的文件。
+     * @return 下标。文件没有注册时返回 -1，这时使用普通的文件描述符。
+     */
+    int getRegisteredFileIndex(int fd) const;
+
+    /**
+     * @brief
+     * 处理轮转中文件操作的完成事件。
+     *
+     * @param request 请求的 user_data。
+     * @param res 完成事件的结果。
+     */
+    void handleRotationCompletion(uint64_t request, int res);
+
+    /**
+     * @brief
+     * 由日志线程调用，定期重新校准时间戳计数器。
+     */
+    void updateTscCalibration();
+
+    /**
+     * @brief
+     * 将日志线程正在使用的输出缓冲区提交给 io_uring 写出，
+     * 并换上一个空闲的输出缓冲区。所有输出缓冲区都在写出时才会等待。
+     *
+     * @param nbytes 当前输出缓冲区中写入的字节数。
+     * @param is_full 缓冲区是否已满。以 O_DIRECT 写入时，已满的缓冲区末尾
+     * 不完整的块留到下一个缓冲区写出，否则填充后立即写出。
+     */
+    void swapOutputBuffer(size_t nbytes, bool is_full);
+
+    /**
+     * @brief
+     * 使用 assembler 将已装载的内容全部写入日志线程正在使用的输出缓冲区，
+     * 缓冲区满时换上新的输出缓冲区。
+     *
+     * @tparam _Assembler LogAssembler 或 binary_log::BinaryLogWriter。
+     * @param copy 不为 nullptr 时，写入的内容同时追加到其中，供附加输出共享。
+     */
+    template <typename _Assembler>
+    inline void writeAssembled(_Assembler& assembler,
+                               std::string* copy = nullptr) {
+        while (assembler.hasRemainingData()) {
+            size_t prev_bytes = assembler.getWritedBytes();
+            assembler.write();
+            if (copy != nullptr)
+                copy->append(getLogBuffer() + prev_bytes,
+                             assembler.getWritedBytes() - prev_bytes);
+            if (assembler.isBufferFull()) {
+                swapOutputBuffer(assembler.getWritedBytes(), true);
+                assembler.setBuffer(getLogBuffer(), getLogBufferSize());
+            }
+        }
+    }
+
+    /**
+     * @brief
+     * 使用 assembler 将已装载的内容全部追加到 dst 末尾，用于为附加输出格式化。
+     *
+     * @tparam _Assembler LogAssembler 或 binary_log::BinaryLogWriter。
+     */
+    template <typename _Assembler>
+    static inline void assembleToString(_Assembler& assembler,
+                                        std::string& dst) {
+        // 一段内容放不下时 assembler 报告缓冲区已满，这时扩大每次写入的空间。
+        size_t chunk_size = 1024;
+        while (assembler.hasRemainingData()) {
+            size_t offset = dst.size();
+            dst.resize(offset + chunk_size);
+            assembler.setBuffer(&dst[offset], chunk_size);
+            assembler.write();
+            dst.resize(offset + assembler.getWritedBytes());
+            if (assembler.isBufferFull())
+                chunk_size *= 2;
+        }
+    }
+
+    /**
+     * @brief
+     * 获取生产者编号在文本日志中的前缀，第一次遇到该生产者时生成前缀。
+     *
+     * @param producer_id 生产者编号，即生产者 StagingBuffer 的 id。
+     * @return const std::string&
+     */
+    inline const std::string& getProducerPrefix(uint32_t producer_id) {
+        if (producer_id >= producer_prefixes_.size())
+            producer_prefixes_.resize(producer_id + 1);
+        std::string& prefix = producer_prefixes_[producer_id];
+        if (prefix.empty())
+            prefix = log_info::MakeProducerPrefix(producer_id);
+        return prefix;
+    }
+
+    /**
+     * @brief
+     * 获取静态信息在文本日志中的前缀，第一次写出该日志时生成前缀。
+     *
+     * @param log_id
+     * @return const std::string&
+     */
+    inline const std::string& getStaticPrefix(size_t log_id) {
+        if (log_id >= static_prefixes_.size())
+            static_prefixes_.resize(log_id + 1);
+        std::string& prefix = static_prefixes_[log_id];
+        if (prefix.empty())
+            prefix = log_info::MakeStaticPrefix(registered_info_.get(log_id));
+        return prefix;
+    }
+
+    /**
+     * @brief
+     * 取出生产者丢弃日志的数量，留到 reportDroppedRecords 中报告。
+     * 可以在持有 producer_buffers_mtx_ 时调用。
+     *
+     * @param buffer 生产者的缓冲区。
+     */
+    void collectDroppedRecords(buffers::StagingBuffer* buffer);
+
+    /**
+     * @brief
+     * 为每个取出过丢弃数量的生产者写出一条说明丢弃数量的日志。
+     * 写出日志可能等待输出缓冲区，不能在持有 producer_buffers_mtx_ 时调用。
+     */
+    void reportDroppedRecords();
+
+    /**
+     * @brief
+     * 写出一条说明丢弃数量的日志，当作该生产者的日志写出。
+     *
+     * @param producer_id 丢弃日志的生产者编号。
+     * @param num_dropped 丢弃的数量。
+     */
+    void reportDroppedRecords(uint32_t producer_id, uint64_t num_dropped);
+
+    /**
+     * @brief
+     * 构造一条说明丢弃数量的日志的动态信息。
+     *
+     * @param num_dropped 丢弃的数量。
+     * @param reason 丢弃的原因。
+     * @return 动态信息，在下一次调用之前有效。
+     */
+    const log_info::DynamicLogInfo* makeDroppedRecordsReport(
+        uint64_t num_dropped, const char* reason);
+
+    /**
+     * @brief
+     * 将一条日志按当前输出格式写入日志线程正在使用的输出缓冲区。
+     *
+     * @param dynamic_log_info 日志的动态信息。
+     * @param producer_id 日志来自的生产者编号。
+     */
+    void writeLogRecord(const log_info::DynamicLogInfo* dynamic_log_info,
+                        uint32_t producer_id);
+
+    /**
+     * @brief
+     * 二进制格式的附加输出第一次写入，或有新的静态信息和时间戳校准时，
+     * 在日志之前写出这些内容。
+     *
+     * @param index 附加输出在 sinks_ 中的下标。
+     * @param log_id 之后写出的日志引用的静态信息。
+     * @return 日志引用的静态信息都已写出时返回 true，否则日志应当被丢弃。
+     */
+    bool writeSinkPreamble(size_t index, size_t log_id);
+
+    /**
+     * @brief
+     * 将 data 完整地追加到附加输出的缓冲区，缓冲区满时写出。
+     * 不等待附加输出的写入。
+     *
+     * @param index 附加输出在 sinks_ 中的下标。
+     * @param data
+     * @return 缓冲区放不下 data 时返回 false，这时不追加任何内容。
+     */
+    bool appendToSink(size_t index, const std::string& data);
+
+    /**
+     * @brief
+     * 向附加输出写出一条说明其丢弃日志数量的日志。
+     *
+     * @param index 附加输出在 sinks_ 中的下标。
+     * @param producer_id 当作该生产者的日志写出。
+     * @return 写出时返回 true，丢弃的数量随之清零。
+     */
+    bool reportSinkDroppedRecords(size_t index, uint32_t producer_id);
+
+    /**
+     * @brief
+     * 将附加输出缓冲区中的日志提交给 io_uring 写出，并换上另一个缓冲区。
+     *
+     * @param index 附加输出在 sinks_ 中的下标。
+     * @param wait 另一个缓冲区仍在写出时是否等待。不等待时留到之后写出。
+     */
+    void flushSink(size_t index, bool wait);
+
+    /**
+     * @brief
+     * 对全部附加输出调用 flushSink。
+     *
+     * @param wait
+     */
+    void flushSinks(bool wait);
+
+    /**
+     * @brief
+     * 将附加输出写出中的缓冲区尚未写出的内容提交到 io_uring。
+     *
+     * @param index 附加输出在 sinks_ 中的下标。
+     * @return io_uring_submit 的返回值。
+     */
+    int submitSinkWrite(size_t index);
+
+    /**
+     * @brief
+     * 处理附加输出写入的完成事件。
+     *
+     * @param request 请求的 user_data。
+     * @param res 完成事件的结果。
+     */
+    void handleSinkCompletion(uint64_t request, int res);
+
+    /**
+     * @brief
+     * 获取日志线程正在使用的输出缓冲区中新日志的写入位置，
+     * 位于从上一个缓冲区带过来的不完整的块之后。
+     */
+    inline char* getLogBuffer() const {
+        return output_buffers_[log_buffer_idx_].data_.get() + carried_bytes_;
+    }
+
+    /**
+     * @brief
+     * 获取日志线程正在使用的输出缓冲区中可以写入新日志的字节数。
+     */
+    inline size_t getLogBufferSize() const {
+        return config::OUTPUT_BUFFER_SIZE - carried_bytes_;
+    }
+
+    /**
+     * @brief
+     * 检查是否有尚未提交写出的日志。
+     */
+    inline bool hasUnsubmittedOutput() const {
+        return getWritedBytes() > 0 ||
+               (carried_bytes_ > 0 && !carried_block_written_);
+    }
+
+    /**
+     * @brief
+     * 获取当前输出格式下日志线程正在使用的输出缓冲区中已写入的字节数。
+     */
+    inline size_t getWritedBytes() const {
+        if (active_output_format_ == OutputFormat::TEXT)
+            return log_assembler_.getWritedBytes();
+        return binary_writer_.getWritedBytes();
+    }
+
+    /**
+     * @brief
+     * 更换输出缓冲区后，让当前输出格式所使用的 assembler 指向新的缓冲区。
+     */
+    inline void resetAssemblerBuffer() {
+        if (active_output_format_ == OutputFormat::TEXT)
+            log_assembler_.setBuffer(getLogBuffer(), getLogBufferSize());
+        else
+            binary_writer_.setBuffer(getLogBuffer(), getLogBufferSize());
+    }
+
+    /**
+     * @brief
+     * 处理 io_uring 中已完成的写入，释放写完的输出缓冲区。
+     *
+     * @param wait 为 true 时至少等待一个写入完成。
+     */
+    void reapCompletions(bool wait);
+
+    /**
+     * @brief
+     * 等待全部已提交的写入完成，包括压缩线程中的输出缓冲区。
+     */
+    void waitForAllWrites();
+
+    /**
+     * @brief
+     * 等待直到有空闲的输出缓冲区。
+     */
+    void waitForFreeOutputBuffer();
+
+    /**
+     * @brief
+     * 将已经写满或需要写出的输出缓冲区交给 io_uring 写出，
+     * 并推进输出文件的偏移量和大小。
+     *
+     * @param buffer_idx 输出缓冲区的下标。
+     * @param nbytes 缓冲区中的日志在文件中所占的字节数。
+     * @return 提交成功时返回 true。
+     */
+    bool writeOutputBuffer(size_t buffer_idx, size_t nbytes);
+
+    /**
+     * @brief
+     * 按提交压缩的顺序取出压缩完成的输出缓冲区，将其中的帧写出。
+     *
+     * @param wait 最早提交的缓冲区尚未压缩完成时是否等待。
+     */
+    void submitCompressedBuffers(bool wait);
+
+    /**
+     * @brief
+     * 将 sqe 准备为对输出文件的 fdatasync。
+     *
+     * @param sqe
+     * @param fd 同步的文件，即输出文件或与之链接的写入所写的文件。
+     * @param sqe_flags 除 IOSQE_FIXED_FILE 外的 sqe 标志。
+     */
+    void prepareSync(io_uring_sqe* sqe, int fd, unsigned int sqe_flags);
+
+    /**
+     * @brief
+     * 按 PERIODIC 方式同步时，检查距上次同步是否已经超过
+     * config::PERIODIC_SYNC_INTERVAL_NS。
+     */
+    bool isPeriodicSyncDue() const;
+
+    /**
+     * @brief
+     * 日志线程空闲时调用。有尚未执行的同步请求，或按 PERIODIC
+     * 到了同步的时间时，在已提交的写入全部完成后同步输出文件。
+     */
+    void syncOutputFileIfNeeded();
+
+    /**
+     * @brief
+     * 将输出缓冲区中尚未写出的内容提交到 io_uring，
+     * 写入该缓冲区记录的文件描述符。
+     *
+     * @param buffer_idx 输出缓冲区的下标。
+     * @return io_uring_submit 的返回值。
+     */
+    int submitLog(size_t buffer_idx);
+
+    /**
+     * @brief
+     * 唤醒休眠中的日志线程。由生产者和析构函数调用。
+     */
+    void wakeUpConsumer();
+
+    /**
+     * @brief
+     * 检查各生产者缓冲区中是否有未处理的日志。
+     */
+    bool hasPendingRecords();
+
+    /**
+     * @brief
+     * 日志线程没有日志可写时调用，随着连续空闲的轮数增加，
+     * 依次选择自旋、让出 CPU 和休眠。
+     *
+     * @param idle_rounds 连续空闲的轮数。
+     * @param has_delayed_records 重排窗口中是否还有等待写出的日志。
+     */
+    void waitForRecords(uint32_t idle_rounds, bool has_delayed_records);
+
+    /**
+     * @brief
+     * 依次处理各生产者缓冲区中的全部日志。
+     */
+    void consumeInBufferOrder();
+
+    /**
+     * @brief
+     * 按时间戳顺序归并各生产者缓冲区中的日志，
+     * 只写出早于重排窗口的日志。
+     *
+     * @param flush_all 为 true 时忽略重排窗口，写出全部日志。
+     */
+    void consumeInTimestampOrder(bool flush_all);
+
+    /**
+     * @brief
+     * 日志线程的主函数。
+     * 后台线程从各个工作线程（生产者）的 staging_buffer_
+     * 中读出日志的动态信息，并与其对应的日志静态信息进行处理，
+     * 写入 Logger 中指定的文件。
+     */
+    void consumerThreadMain();
+
+  private:
+    // 已经执行过的 OLOG 调用点。
+    struct LogSite {
+        const char* filename_;
+        int line_number_;
+        const char* format_;
+        std::atomic<LogSiteState>* state_;
+    };
+
+    // 调用点规则，文件名、行和格式串都匹配时设置调用点的状态。
+    struct LogSiteRule {
+        // 为空时匹配全部文件。
+        std::string file_glob_;
+
+        // 为 0 时匹配全部行。
+        int line_number_;
+
+        // 为空时不检查格式串。
+        std::string format_substring_;
+
+        LogSiteState state_;
+
+        bool matches(const LogSite& site) const;
+    };
+
+    // 对 log_sites_ 和 log_site_rules_ 进行保护。
+    std::mutex log_sites_mtx_;
+
+    // 已经登记的调用点。
+    std::vector<LogSite> log_sites_;
+
+    // 按设置顺序排列的调用点规则，后设置的规则优先。
+    std::vector<LogSiteRule> log_site_rules_;
+
+    // 日志输出文件的格式描述符。仅由日志线程修改。
+    int output_fd_;
+
+    // 由 SetLogFile 打开、尚未被日志线程换上的文件描述符，没有时为 -1。
+    std::atomic<int> pending_output_fd_;
+
+    // 对 pending_output_path_、pending_compressor_、附加输出的变化
+    // 和更换 pending_output_fd_ 进行保护。
+    std::mutex pending_output_mtx_;
+
+    // pending_output_fd_ 对应的文件的绝对路径，用于轮转。
+    std::string pending_output_path_;
+
+    // 由 SetCompressor 设置、尚未被日志线程换上的压缩器。
+    std::unique_ptr<compression::Compressor> pending_compressor_;
+
+    // 是否调用过 SetCompressor 且尚未被日志线程处理。
+    std::atomic<bool> compressor_changed_;
+
+    // 最近一次 SetCompressor 是否设置了压缩器。
+    std::atomic<bool> compression_enabled_;
+
+    // 由 AddSink 添加的附加输出。
+    struct Sink {
+        // AddSink 返回的编号。
+        int id_;
+
+        int fd_;
+
+        // 移除时是否关闭 fd_。
+        bool owns_fd_;
+
+        // 写入该输出的最高日志等级。
+        log_info::LogLevel max_level_;
+
+        OutputFormat format_;
+
+        // 轮流使用的两个缓冲区，一个由日志线程写入日志，另一个在写出中。
+        // 同一时间只有一个写入，写入的顺序就是日志的顺序。
+        std::unique_ptr<char[]> buffers_[2];
+
+        // 日志线程正在写入的缓冲区的下标。
+        size_t active_;
+
+        // 正在写入的缓冲区中日志的字节数。
+        size_t nbytes_;
+
+        // 另一个缓冲区是否在写出中。
+        bool writing_;
+
+        // 另一个缓冲区中提交写出的字节数。
+        size_t write_bytes_;
+
+        // 另一个缓冲区中已经写出的字节数，发生短写时从这里继续写。
+        size_t written_bytes_;
+
+        // 二进制格式的输出中是否已经写出了文件头和最新的时间戳校准。
+        bool binary_header_written_;
+        bool binary_calibration_written_;
+
+        // 二进制格式的输出中已经写出的静态信息数量。
+        size_t num_dumped_info_;
+
+        // 缓冲区放不下而丢弃、尚未报告的日志数量。
+        uint64_t num_dropped_;
+    };
+
+    // 由 AddSink 添加、尚未被日志线程换上的附加输出。
+    std::vector<Sink> pending_sinks_;
+
+    // 由 RemoveSink 移除、尚未被日志线程处理的附加输出的编号。
+    std::vector<int> pending_sink_removals_;
+
+    // 是否有尚未被日志线程处理的附加输出的变化。
+    std::atomic<bool> sinks_changed_;
+
+    // 尚未被移除的附加输出的编号。
+    std::vector<int> live_sink_ids_;
+
+    // 下一个附加输出的编号。
+    int next_sink_id_;
+
+    // 用户设置的输出格式。
+    std::atomic<OutputFormat> output_format_;
+
+    // 用户设置的时间戳精度。
+    std::atomic<log_info::TimestampPrecision> timestamp_precision_;
+
+    // 是否按时间戳顺序输出日志。
+    std::atomic<bool> ordered_output_;
+
+    // 生产者缓冲区空间不足时的处理方式。
+    std::atomic<OverflowPolicy> overflow_policy_;
+
+    // 日志线程一次休眠的最长时间（纳秒）。
+    std::atomic<int64_t> max_flush_latency_ns_;
+
+    // 之后打开的日志文件的写入方式。
+    std::atomic<WriteMode> write_mode_;
+
+    // 日志写入文件后的持久化方式。
+    std::atomic<DurabilityPolicy> durability_policy_;
+
+    // 按大小轮转日志文件的阈值（字节），为 0 时不按大小轮转。
+    std::atomic<uint64_t> rotation_size_;
+
+    // 按时间轮转日志文件的间隔（纳秒），为 0 时不按时间轮转。
+    std::atomic<int64_t> rotation_interval_ns_;
+
+    // 日志线程休眠时为 1。生产者每次写入日志都会读取它，
+    // 所以独占一个缓存行，只在日志线程休眠和被唤醒时才会被修改。
+    alignas(buffers::CACHE_LINE_SIZE) std::atomic<uint32_t> consumer_parked_;
+
+    // io_uring 的数据结构。对齐到新的缓存行，与 consumer_parked_ 分开。
+    alignas(buffers::CACHE_LINE_SIZE) io_uring ring;
+
+    // 提交到 sq 上、尚未处理完成事件的 sqe 数量。
+    unsigned int num_sqes_;
+
+    // 释放 aligned_alloc 分配的输出缓冲区。
+    struct AlignedDeleter {
+        void operator()(char* ptr) const { std::free(ptr); }
+    };
+
+    // 日志线程格式化日志并交给 io_uring 写出的缓冲区。
+    struct OutputBuffer {
+        // 按 config::DIRECT_IO_ALIGNMENT 对齐，可以直接用于 O_DIRECT 写入。
+        std::unique_ptr<char[], AlignedDeleter> data_;
+
+        // 提交写出的字节数。
+        size_t nbytes_;
+
+        // 已经写入文件的字节数，发生短写时从这里继续写。
+        size_t written_bytes_;
+
+        // 写入的文件描述符。
+        int fd_;
+
+        // 写入的文件偏移量，为 -1 时写在文件的当前位置。
+        int64_t offset_;
+
+        // 是否要等之前的写入全部完成才开始，写在文件的当前位置
+        // 或重写上一次写入的最后一个块时需要。
+        bool drain_;
+
+        // 写入之后是否链接一个 fdatasync，只对第一次提交有效。
+        bool sync_;
+
+        // 压缩后的帧，第一次开启压缩时分配。
+        std::unique_ptr<char[]> frame_data_;
+
+        // 写出的是 frame_data_ 而不是 data_。
+        bool framed_;
+    };
+
+    // 全部输出缓冲区，数量为 config::NUM_OUTPUT_BUFFERS。
+    std::vector<OutputBuffer> output_buffers_;
+
+    // 没有在写出中的输出缓冲区的下标，不包括日志线程正在使用的缓冲区。
+    std::vector<size_t> free_output_buffers_;
+
+    // 日志线程正在使用的输出缓冲区的下标。
+    size_t log_buffer_idx_;
+
+    // 注册的文件表的大小。输出文件和轮转换下的文件各占一个位置，
+    // 每次轮转交替使用，换上新文件时原来文件的请求仍引用原来的位置。
+    static constexpr unsigned int NUM_REGISTERED_FILES = 2;
+
+    // 输出文件在 io_uring 注册的文件表中的下标。
+    int output_file_index_;
+
+    // 输出缓冲区是否已经注册到 io_uring，注册后以下标作为固定缓冲区的编号。
+    bool buffers_registered_;
+
+    // 输出文件是否已经注册到 io_uring。
+    bool files_registered_;
+
+    // io_uring 是否运行在 SQPOLL 模式。
+    bool sqpoll_enabled_;
+
+    // 内核支持的 io_uring 特性，即 io_uring_params::features。
+    unsigned int io_uring_features_;
+
+    // SQPOLL 模式支持普通文件描述符时的特性位，旧的头文件中没有定义。
+#ifdef IORING_FEAT_SQPOLL_NONFIXED
+    static constexpr unsigned int SQPOLL_NONFIXED_FEATURE =
+        IORING_FEAT_SQPOLL_NONFIXED;
+#else
+    static constexpr unsigned int SQPOLL_NONFIXED_FEATURE = 0;
+#endif
+
+    // 预分配请求的 user_data，与输出缓冲区的下标区分。
+    static constexpr uint64_t PREALLOCATION_REQUEST = UINT64_MAX;
+
+    // fdatasync 请求的 user_data。
+    static constexpr uint64_t SYNC_REQUEST = UINT64_MAX - 1;
+
+    // 轮转日志文件时各个文件操作的 user_data。
+    static constexpr uint64_t ROTATION_RENAME_REQUEST = UINT64_MAX - 2;
+    static constexpr uint64_t ROTATION_OPEN_REQUEST = UINT64_MAX - 3;
+    static constexpr uint64_t ROTATION_TRIM_REQUEST = UINT64_MAX - 4;
+    static constexpr uint64_t ROTATION_CLOSE_REQUEST = UINT64_MAX - 5;
+
+    // 附加输出的写入以该值加上附加输出的编号为 user_data。
+    static constexpr uint64_t SINK_WRITE_REQUEST = 1ULL << 32;
+
+    // 下一次写入之后需要同步输出文件。
+    bool sync_requested_;
+
+    // 上次同步之后是否提交过写入。
+    bool has_unsynced_writes_;
+
+    // 上次提交 fdatasync 时的时间戳计数器。
+    uint64_t last_sync_tsc_;
+
+    // 是否自行维护输出文件的偏移量并使用带偏移量的写入。
+    bool output_positioned_;
+
+    // 下一个输出缓冲区写入的文件偏移量。
+    int64_t output_offset_;
+
+    // 已经提交预分配的文件末端。
+    int64_t preallocated_end_;
+
+    // 是否有尚未完成的预分配请求。
+    bool preallocating_;
+
+    // 预分配失败（如文件系统不支持）后不再尝试。
+    bool preallocation_failed_;
+
+    // 输出文件是否以 O_DIRECT 打开，此时写入的位置和长度都按
+    // config::DIRECT_IO_ALIGNMENT 对齐。
+    bool output_direct_;
+
+    // 日志线程正在使用的输出缓冲区开头从上一个缓冲区带过来的字节数，
+    // 即文件末尾不完整的块，新日志写在它们之后。
+    size_t carried_bytes_;
+
+    // 带过来的块是否已经填充后写出过，之后的写入会重写该块。
+    bool carried_block_written_;
+
+    // 输出文件的绝对路径，输出到标准输出时为空。
+    std::string output_path_;
+
+    // 输出文件的打开方式，轮转时以相同的方式打开新文件。
+    // 输出文件不是普通文件时为 -1，不进行轮转。
+    int output_file_flags_;
+
+    // 输出文件的大小，包括已经提交但尚未完成的写入。
+    uint64_t output_file_size_;
+
+    // 换上输出文件时单调时钟的纳秒数。
+    int64_t output_file_start_ns_;
+
+    // 日志文件轮转的阶段。
+    enum class RotationState : uint8_t {
+        // 没有进行中的轮转。
+        IDLE = 0,
+
+        // 已经提交重命名和打开新文件的请求。
+        OPENING,
+
+        // 新文件已经打开，等待在缓冲区边界换上。
+        READY,
+
+        // 已经换上新文件，等待原来文件的写入完成。
+        RETIRING,
+
+        // 正在关闭原来的文件。
+        CLOSING
+    };
+
+    RotationState rotation_state_;
+
+    // 轮转时日志文件被重命名为的路径，在 renameat 完成前需要保持有效。
+    std::string rotation_archive_path_;
+
+    // 已经打开、尚未换上的新文件，没有时为 -1。
+    int rotated_fd_;
+
+    // 轮转换下、正在关闭的文件，没有时为 -1。
+    int retiring_fd_;
+
+    // 轮转换下的文件中日志的实际长度。
+    int64_t retiring_size_;
+
+    // 关闭轮转换下的文件前是否需要截断，参见 trimOutputFile。
+    bool retiring_trim_;
+
+    // 轮转失败（如没有权限重命名）后不再尝试，直到换上新的输出文件。
+    bool rotation_failed_;
+
+    // 内核不支持通过 io_uring 截断文件时，轮转换下的文件不再截断。
+    bool ftruncate_unsupported_;
+
+    // 压缩输出缓冲区的线程，第一次开启压缩时创建。
+    std::unique_ptr<compression::CompressionWorker> compression_worker_;
+
+    // 输出缓冲区是否压缩后再写出。
+    bool compressing_;
+
+    // 存储已注册的日志的静态信息。生产者不加锁地注册，
+    // 日志线程按 log_id 直接读取，不需要副本。
+    registry::StaticInfoRegistry registered_info_;
+
+    // 每条静态信息在文本日志中的前缀，以 log_id 为下标，
+    // 由日志线程在第一次写出该日志时生成，尚未生成的为空。
+    std::vector<std::string> static_prefixes_;
+
+    // 为每个线程都分配一个单独的缓冲区，用于传输日志的动态信息。
+    static thread_local buffers::StagingBuffer* staging_buffer_;
+
+    // 与 staging_buffer_ 一同设置，FinishAlloc 通过它访问 Logger 单例，
+    // 不必每次经过 GetInstance 中局部静态变量的初始化检查。
+    static thread_local Logger* thread_logger_;
+
+    // 通知日志线程析构相应线程的缓冲区。
+    static thread_local buffers::StagingBuffer::DestructGuard
+        staging_buffer_destruct_guard_;
+
+    // 对 producer_buffers_ 和 next_buffer_id_ 进行保护。
+    std::mutex producer_buffers_mtx_;
+
+    // 存储所有生产者的 StagingBuffer。
+    std::vector<buffers::StagingBuffer*> producer_buffers_;
 
     // 为下一个线程的 staging_buffer_ 分配的 id。
     uint32_t next_buffer_id_;
 
-    std::unique_ptr<char[]> buffer_for_log_;
+    // 以下属性仅由日志线程使用。
+
+    // 日志线程当前使用的输出格式。
+    OutputFormat active_output_format_;
+
+    // 将日志格式化为文本。
+    log_info::LogAssembler log_assembler_;
+
+    // 各生产者编号在文本日志中的前缀，以 StagingBuffer 的 id 为下标。
+    std::vector<std::string> producer_prefixes_;
 
-    std::unique_ptr<char[]> buffer_for_io_;
+    // 以二进制格式写出日志。
+    binary_log::BinaryLogWriter binary_writer_;
+
+    // 日志线程正在使用的附加输出。
+    std::vector<Sink> sinks_;
+
+    // 日志文件使用另一种格式时，为附加输出格式化日志。
+    log_info::LogAssembler sink_assembler_;
+    binary_log::BinaryLogWriter sink_binary_writer_;
+
+    // 当前日志的文本和二进制格式，由同一格式的附加输出共享。
+    std::string sink_text_;
+    std::string sink_binary_;
+
+    // 二进制格式的附加输出在日志之前写出的内容。
+    std::string sink_preamble_;
+
+    // 将生产者记录的时间戳计数器转换为时间。
+    utils::TscClock tsc_clock_;
+
+    // 按时间戳顺序输出时，一个生产者缓冲区中下一条待写出的日志。
+    struct OrderedCursor {
+        // 下一条日志的时间戳。
+        uint64_t timestamp_;
+
+        buffers::StagingBuffer* buffer_;
+
+        // 下一条日志的位置。
+        char* read_pos_;
+
+        // 本次 peek 得到的数据中尚未处理的字节数。
+        size_t remaining_bytes_;
+    };
+
+    // 以时间戳为键的小顶堆，复用以避免每轮分配内存。
+    std::vector<OrderedCursor> ordered_heap_;
+
+    // 报告丢弃日志数量的日志所注册的 id，在第一次报告时注册。
+    std::atomic<int> dropped_records_log_id_;
+
+    // makeDroppedRecordsReport 构造的动态信息。
+    alignas(log_info::DynamicLogInfo) char
+        dropped_records_report_[sizeof(log_info::DynamicLogInfo) + 128];
+
+    // 已经取出、尚未报告的丢弃数量。
+    struct DroppedRecords {
+        uint32_t producer_id_;
+
+        uint64_t num_dropped_;
+    };
+
+    // 复用以避免每轮分配内存。
+    std::vector<DroppedRecords> dropped_records_;
+
+    // 当前二进制文件中是否已经写出了文件头。
+    bool binary_header_written_;
+
+    // 当前二进制文件中是否已经写出了最新的时间戳校准。
+    bool binary_calibration_written_;
+
+    // 当前二进制文件中已经写出的静态信息数量。
+    // 静态信息按 log_id 的顺序写出，所以 log_id 小于该值的静态信息都已写出。
+    size_t num_dumped_info_;
 
     // 写入日志的线程。
     std::thread consumer_thread_;
 
     // 指示日志线程应该结束工作。
-    bool consumer_should_exit_;
+    std::atomic<bool> consumer_should_exit_;
 };
 
+/**
+ * @brief
+ * 检查 OLOG 调用点是否应当输出日志。通常只需读取调用点的状态，
+ * 按日志等级决定时再读取一次日志等级。
+ *
+ * @param state 调用点的状态。
+ * @param severity 日志等级。
+ * @param filename 调用点所在的文件，只在第一次执行时使用。
+ * @param line_number 调用点所在的行，只在第一次执行时使用。
+ * @param format 调用点的格式串，只在第一次执行时使用。
+ */
+inline bool IsLogSiteEnabled(std::atomic<LogSiteState>& state,
+                             log_info::LogLevel severity, const char* filename,
+                             int line_number, const char* format) {
+    LogSiteState site_state = state.load(std::memory_order_relaxed);
+    if (site_state == LogSiteState::BY_LEVEL)
+        return IsLogLevelEnabled(severity);
+    if (site_state == LogSiteState::UNREGISTERED)
+        site_state =
+            Logger::RegisterLogSite(state, filename, line_number, format);
+    if (site_state == LogSiteState::BY_LEVEL)
+        return IsLogLevelEnabled(severity);
+    return site_state == LogSiteState::ENABLED;
+}
+
 }  // namespace logger
 }  // namespace olog
 
@@ -2,43 +2,37 @@
 #define OLOG_OLOG_H
 
 #include <array>
+#include <cinttypes>
 #include <cstdio>
 
 #include "log_info.h"
 #include "logger.h"
 #include "portability.h"
+#include "rate_limit.h"
 #include "utils.h"
 
 namespace olog {
 
-template <size_t _FormatLength, size_t _NumParams, size_t _NumConversions,
-          typename... _Args>
-inline void Log(int& log_id, const char* filename, const int line_num,
-                log_info::LogLevel severity, const char (&fmt)[_FormatLength],
-                const char* conversion_storage,
-                const std::array<log_info::FormatFragment, _NumConversions>&
-                    format_fragments,
+/**
+ * @brief
+ * 将一条日志的动态信息写入当前线程的缓冲区。由 OLOG 在检查日志等级后调用。
+ */
+template <size_t _NumParams, typename... _Args>
+inline void Log(const log_info::StaticLogInfo& static_info,
+                std::atomic<int>& log_id,
                 const std::array<log_info::ParamType, _NumParams>& param_types,
                 _Args... args) {
     static_assert(
         _NumParams == sizeof...(args),
         "The number of parameters is different from the number of arguments");
 
-    /*比当前日志等级高则直接退出。*/
-    if (severity > logger::Logger::GetLogLevel())
-        return;
-
-    // 向 Logger 注册该日志的静态信息。
-    if (log_id == log_info::UNREGISTERED_LOG_ID) {
-        static std::array<size_t, _NumParams> param_sizes;
-        log_info::GetParamSizes(param_types, param_sizes, args...);
-
-        log_info::StaticLogInfo info(
-            filename, line_num, severity, _FormatLength, _NumConversions,
-            _NumParams, fmt, conversion_storage, format_fragments.data(),
-            param_types.data(), param_sizes.data());
-        logger::Logger::RegisterLogInfo(info, log_id);
-    }
+    // 向 Logger 注册该日志的静态信息。链接时收集的调用点在构造 Logger 时
+    // 已经注册，这里只处理其他平台以及没有链接时注册的模块中的调用点。
+    // 在所有编译配置下保持相同，混用不同配置的目标文件时不违反 ODR。
+    // 其他线程正在注册（RESERVED_LOG_ID）时同样进入，等待它分配的 id。
+    // 链接时注册时从不进入，否则每个调用点只进入一次，总是标记为冷分支。
+    if (OLOG_UNLIKELY(log_id.load(std::memory_order_relaxed) < 0))
+        logger::Logger::RegisterLogInfo(static_info, log_id);
 
     // 存储实参中字符串的长度（与 strlen 或 wcslen 的计算值相同）的数组。+1
     // 是防止在无参情况下出错。
@@ -48,7 +42,8 @@ inline void Log(int& log_id, const char* filename, const int line_num,
     // 该变量用于指示实参中字符串被存储的长度，所以使用 size_t 类型。
     size_t pre_precision = 0;
 
-    int64_t timestamp = utils::GetMsSystemClockInterval();
+    // 只读取时间戳计数器，由日志线程将其转换为时间。
+    uint64_t timestamp = utils::ReadTsc();
 
     size_t alloc_size = log_info::GetArgSizes(param_types, string_sizes,
                                               pre_precision, args...) +
@@ -56,6 +51,11 @@ inline void Log(int& log_id, const char* filename, const int line_num,
 
     // 获取写入位置。
     char* write_pos = logger::Logger::ReserveAlloc(alloc_size);
+
+    // 缓冲区已满且不允许等待，丢弃这条日志。
+    if (write_pos == nullptr)
+        return;
+
 #ifndef NDEBUG
     char* original_write_pos = write_pos;
 #endif
@@ -64,9 +64,11 @@ inline void Log(int& log_id, const char* filename, const int line_num,
     log_info::DynamicLogInfo* dynamic_info =
         new (write_pos) log_info::DynamicLogInfo();
     write_pos += sizeof(log_info::DynamicLogInfo);
-    dynamic_info->log_id_ = log_id;
+    // 链接时收集的调用点在 Logger 构造时分配 log_id，
+    // ReserveAlloc 保证 Logger 已经构造。
+    dynamic_info->log_id_ = log_id.load(std::memory_order_relaxed);
     dynamic_info->info_size_ = alloc_size;
-    dynamic_info->ms_timestamp_ = timestamp;
+    dynamic_info->timestamp_ = timestamp;
 
     // 写入实参。
     size_t args_size =
@@ -94,20 +96,145 @@ static void OLOG_PRINTF_FORMAT_ATTR(1, 2)
  * 为了防止出现问题，OLog 对日志等级不使用宏定义。
  */
 using LogLevel = olog::log_info::LogLevel;
+using DurabilityPolicy = olog::logger::DurabilityPolicy;
 using Logger = olog::logger::Logger;
+using OutputFormat = olog::logger::OutputFormat;
+using OverflowPolicy = olog::logger::OverflowPolicy;
+using TimestampPrecision = olog::log_info::TimestampPrecision;
+using WriteMode = olog::logger::WriteMode;
+
+/*
+ * 编译期保留的最低日志等级，取 LogLevel 中的名称，例如
+ * -DOLOG_COMPILE_TIME_MIN_LEVEL=INFO。比它更详细的 OLOG 在编译期被丢弃，
+ * 不生成代码和静态数组，运行时没有任何开销。
+ * 定义为 NONE 时丢弃全部日志。定义后 OLOG 的日志等级必须是常量表达式。
+ * 默认不丢弃任何日志。
+ */
+#ifdef OLOG_COMPILE_TIME_MIN_LEVEL
+#define OLOG_IS_COMPILED_IN(severity) \
+    ((severity) <= olog::log_info::LogLevel::OLOG_COMPILE_TIME_MIN_LEVEL)
+#else
+#define OLOG_IS_COMPILED_IN(severity) true
+#endif
+
+#ifdef OLOG_LINK_TIME_REGISTRATION
+/*
+ * 向 olog_static_info 段写入调用点的 logger::StaticInfoEntry。
+ * 使用汇编而不是 section 属性，因为 GCC 不允许内联函数（COMDAT）
+ * 和普通函数中的静态变量位于同一个具名段中。
+ */
+#define OLOG_REGISTER_STATIC_INFO(static_info, log_id, site_state)        \
+    asm(".pushsection olog_static_info, \"aw\"\n\t"                       \
+        ".balign 8\n\t"                                                   \
+        ".quad %c0, %c1, %c2\n\t"                                         \
+        ".popsection" ::"i"(&(static_info)),                              \
+        "i"(&(log_id)), "i"(&(site_state)))
+#else
+#define OLOG_REGISTER_STATIC_INFO(static_info, log_id, site_state) ((void)0)
+#endif
+
+/**
+ * @brief
+ * 以 printf 格式写出一条日志。日志等级比 Logger::SetLogLevel
+ * 设置的等级更详细时在运行时忽略，比 OLOG_COMPILE_TIME_MIN_LEVEL
+ * 更详细时在编译期丢弃。日志等级必须是常量表达式，
+ * 调用点的静态信息在编译期构造，在 Logger 构造时统一注册。
+ */
+#define OLOG(severity, format, ...)                                  \
+    do {                                                             \
+        /* 被丢弃的语句中的静态数组和函数模板不会被实例化。*/ \
+        if constexpr (OLOG_IS_COMPILED_IN(severity)) {               \
+            OLOG_INTERNAL(severity, format, ##__VA_ARGS__);          \
+        }                                                            \
+    } while (false)
 
 /**
  * @brief
- *
+ * 每 n 次调用写出一次，从第一次调用开始。
  */
-#define OLOG(severity, format, ...)                                                               \
+#define OLOG_EVERY_N(severity, n, format, ...) \
+    OLOG_LIMITED(severity, olog::rate_limit::EveryN(n), format, ##__VA_ARGS__)
+
+/**
+ * @brief
+ * 只写出前 n 次调用。
+ */
+#define OLOG_FIRST_N(severity, n, format, ...) \
+    OLOG_LIMITED(severity, olog::rate_limit::FirstN(n), format, ##__VA_ARGS__)
+
+/**
+ * @brief
+ * 两次写出之间至少间隔 ms 毫秒。
+ */
+#define OLOG_EVERY_MS(severity, ms, format, ...)                          \
+    OLOG_LIMITED(severity,                                                \
+                 olog::rate_limit::EveryInterval((ms) * 1000LL * 1000LL), \
+                 format, ##__VA_ARGS__)
+
+/**
+ * @brief
+ * 以令牌桶限流，平均每秒最多写出 rate 次，最多连续写出 burst 次。
+ */
+#define OLOG_RATE_LIMITED(severity, rate, burst, format, ...)                 \
+    OLOG_LIMITED(severity, olog::rate_limit::TokenBucket(rate, burst), format, \
+                 ##__VA_ARGS__)
+
+/**
+ * @brief
+ * 经过 limiter 限流的 OLOG。limiter 是 olog::rate_limit 中的限流器，
+ * 在调用点静态存储。有日志被跳过时，下一条写出的日志末尾会附加被跳过的次数。
+ */
+#define OLOG_LIMITED(severity, limiter, format, ...)                                              \
+    do {                                                                                          \
+        if constexpr (OLOG_IS_COMPILED_IN(severity)) {                                            \
+            static std::atomic<olog::logger::LogSiteState> site_state{                            \
+                olog::logger::LogSiteState::UNREGISTERED};                                        \
+            static auto site_limiter = limiter;                                                   \
+            uint64_t num_suppressed = 0;                                                          \
+            if (olog::logger::IsLogSiteEnabled(site_state, severity, __FILE__,                    \
+                                               __LINE__, format) &&                               \
+                site_limiter.shouldLog(num_suppressed)) {                                         \
+                if (num_suppressed == 0) {                                                        \
+                    OLOG_EMIT_INTERNAL(severity, format, ##__VA_ARGS__);                          \
+                } else {                                                                          \
+                    OLOG_EMIT_INTERNAL(severity, format " (suppressed %" PRIu64 ")",              \
+                                       ##__VA_ARGS__, num_suppressed);                            \
+                }                                                                                 \
+            }                                                                                     \
+        }                                                                                         \
+    } while (false)
+
+/**
+ * @brief
+ * OLOG 的实现，不检查 OLOG_COMPILE_TIME_MIN_LEVEL。
+ */
+#define OLOG_INTERNAL(severity, format, ...)                                                      \
+    do {                                                                                          \
+        /* 该调用点在运行时的开关状态，第一次执行时向 Logger 登记。*/     \
+        static std::atomic<olog::logger::LogSiteState> site_state{                                \
+            olog::logger::LogSiteState::UNREGISTERED};                                            \
+                                                                                                  \
+        /* 在对参数求值之前检查调用点的状态和日志等级，                     \
+         * 被忽略的日志通常只有一次读取和分支。*/                               \
+        if (olog::logger::IsLogSiteEnabled(site_state, severity, __FILE__,                        \
+                                           __LINE__, format)) {                                   \
+            OLOG_EMIT_INTERNAL(severity, format, ##__VA_ARGS__);                                  \
+        }                                                                                         \
+    } while (false)
+
+/**
+ * @brief
+ * 写出一条日志，不做任何检查。参数只在这里被求值。
+ * 调用点的状态 site_state 由外层的 OLOG_INTERNAL 或 OLOG_LIMITED 定义。
+ */
+#define OLOG_EMIT_INTERNAL(severity, format, ...)                                                 \
     do {                                                                                          \
         /* 静态存储格式串，供 Logger 使用。*/                                         \
         static constexpr char format_str[] = format;                                              \
                                                                                                   \
-        /* 该条日志所对应的 id。静态存储，初始化为 UNREGISTERED，在经 Looger \
-         * 注册后分配一个唯一值。*/                                                    \
-        static int log_id = olog::log_info::UNREGISTERED_LOG_ID;                                  \
+        /* 该条日志所对应的 id。静态存储，初始化为 UNREGISTERED，              \
+         * 由 Logger 在启动时或第一次执行时分配一个唯一值。*/                 \
+        static std::atomic<int> log_id{olog::log_info::UNREGISTERED_LOG_ID};                      \
                                                                                                   \
         /* 格式串所需参数数量。 */                                                      \
         constexpr size_t num_parameters =                                                         \
@@ -138,15 +265,25 @@ using Logger = olog::logger::Logger;
                 olog::log_info::GetFormatFragments<num_conversions>(                              \
                     format_str, conversion_storage);                                              \
                                                                                                   \
+        /* 实参所占大小的数组，由实参类型决定。静态存储。*/                \
+        static constexpr std::array<size_t, num_parameters> param_sizes =                         \
+            olog::log_info::MakeParamSizes(                                                       \
+                param_types, decltype(olog::log_info::ArgTypes(__VA_ARGS__))());                  \
+                                                                                                  \
+        /* 日志的静态信息，在编译期构造，日志等级必须是常量表达式。*/ \
+        static constexpr olog::log_info::StaticLogInfo static_info(                               \
+            __FILE__, __LINE__, severity, sizeof(format_str), num_conversions,                    \
+            num_parameters, format_str, conversion_storage.data(),                                \
+            format_fragments.data(), param_types.data(), param_sizes.data());                     \
+        OLOG_REGISTER_STATIC_INFO(static_info, log_id, site_state);                               \
+                                                                                                  \
         /* 对参数进行检查。使用 if(false){...}                                          \
          * 防止对传入的参数进行求值，例如 i++。 */                                \
         if (false) {                                                                              \
             olog::CheckFormat(format, ##__VA_ARGS__);                                             \
         }                                                                                         \
                                                                                                   \
-        olog::Log(log_id, __FILE__, __LINE__, severity, format_str,                               \
-                  conversion_storage.data(), format_fragments, param_types,                       \
-                  ##__VA_ARGS__);                                                                 \
+        olog::Log(static_info, log_id, param_types, ##__VA_ARGS__);                               \
     } while (false)
 
 #endif
\ No newline at end of file
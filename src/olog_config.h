@@ -10,15 +10,80 @@ namespace config {
 
 static const uint32_t STORAGE_BUFFER_SIZE = 1024 * 1024;
 
-static const int LOG_FILE_FLAGS =
-    O_CREAT | O_APPEND | O_RDWR | O_DSYNC | O_NOATIME;
+// 持久化由 Logger::SetDurabilityPolicy 决定，不在打开文件时指定 O_DSYNC。
+static const int LOG_FILE_FLAGS = O_CREAT | O_APPEND | O_RDWR | O_NOATIME;
 
-static const size_t DOUBLE_BUFFER_SIZE = 1024 * 1024 * 8;
+// 日志线程输出缓冲区的大小。
+static const size_t OUTPUT_BUFFER_SIZE = 1024 * 1024 * 4;
 
-static const uint32_t IO_URING_ENTRIES = 1;
+// 以 WriteMode::DIRECT 写入时，内存地址、文件偏移量和写入长度的对齐要求，
+// 同时也是输出缓冲区的对齐。
+static const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+static_assert(OUTPUT_BUFFER_SIZE % DIRECT_IO_ALIGNMENT == 0,
+              "OUTPUT_BUFFER_SIZE must be a multiple of DIRECT_IO_ALIGNMENT");
+
+// 输出缓冲区的数量，也是同时提交给 io_uring 的写入数量的上限。
+// 只有全部输出缓冲区都在写出时，日志线程才会等待写入完成。
+static const uint32_t NUM_OUTPUT_BUFFERS = 4;
+
+// 由 Logger::AddSink 添加的附加输出的数量上限，不包括日志文件。
+static const uint32_t MAX_SINKS = 8;
+
+// 每个附加输出有两个这样大小的缓冲区，一个写入日志，另一个在写出中。
+// 两个都用满时丢弃之后的日志，而不是等待附加输出的写入。
+static const size_t SINK_BUFFER_SIZE = 1024 * 1024;
+
+// 除写入外还需要容纳一个预分配请求、一个 fdatasync，
+// 以及轮转日志文件时一同提交的两个文件操作。
+// 每个附加输出同时最多有一个写入。
+static const uint32_t IO_URING_ENTRIES = NUM_OUTPUT_BUFFERS + 4 + MAX_SINKS;
+
+// 以 WriteMode::POSITIONED 写入时，每次为日志文件预分配的空间大小。
+// 写入位置距已预分配的末端不足全部输出缓冲区的大小时预分配下一段。
+static const int64_t PREALLOCATION_EXTENT_SIZE = 64 * 1024 * 1024;
 
 static const unsigned int IO_URING_INIT_FLAGS = 0;
 
+// 是否使用 SQPOLL 模式。由内核线程轮询提交队列，日志线程提交写入时
+// 不再需要系统调用。内核不支持、权限不足，或者 SQPOLL 模式下不能使用
+// 普通文件描述符（Linux 5.11 之前）时自动退回普通模式。
+static const bool IO_URING_SQPOLL = false;
+
+// SQPOLL 模式下内核线程空闲多少毫秒后进入休眠。
+static const unsigned int IO_URING_SQPOLL_IDLE_MS = 2000;
+
+// SQPOLL 模式下内核线程绑定的 CPU，小于 0 时不绑定。
+static const int IO_URING_SQPOLL_CPU = -1;
+
+// 以 DurabilityPolicy::PERIODIC 写入时两次 fdatasync 之间的间隔（纳秒）。
+static const int64_t PERIODIC_SYNC_INTERVAL_NS = 1000 * 1000 * 1000;
+
+// 时间戳计数器初始校准时忙等待的纳秒数。
+static const int64_t TSC_INITIAL_CALIBRATION_NS = 1000 * 1000;
+
+// 日志线程重新校准时间戳计数器的间隔（纳秒）。
+static const int64_t TSC_CALIBRATION_INTERVAL_NS = 1000 * 1000 * 1000;
+
+// 按时间戳顺序输出时的重排窗口（纳秒）。
+// 日志在产生后至少经过该时间才会被写出，以等待其他线程中更早的日志。
+static const int64_t ORDERED_OUTPUT_WINDOW_NS = 2 * 1000 * 1000;
+
+// 日志线程没有日志可写时，先自旋的轮数。
+static const uint32_t CONSUMER_IDLE_SPIN_ROUNDS = 64;
+
+// 自旋之后让出 CPU 的轮数，之后休眠直到被生产者唤醒。
+static const uint32_t CONSUMER_IDLE_YIELD_ROUNDS = 64;
+
+// 默认的最大写出延迟（纳秒），即日志线程一次休眠的最长时间。
+static const int64_t DEFAULT_MAX_FLUSH_LATENCY_NS = 100 * 1000 * 1000;
+
+// 静态信息注册表第一个段的大小，之后每个段的大小依次翻倍。
+static const size_t REGISTRY_FIRST_SEGMENT_SIZE = 1024;
+
+// 限流的 OLOG 变体按线程将被跳过的次数分散到这么多个缓存行中计数。
+static const uint32_t RATE_LIMIT_COUNTER_SHARDS = 8;
+
 }  // namespace config
 }  // namespace olog
 
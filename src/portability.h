@@ -7,4 +7,25 @@
     __attribute__((__format__(__printf__, string_index, first_to_check)))
 #endif
 
+// 提示编译器条件通常不成立，分支被移出热路径。
+#ifdef __GNUC__
+#define OLOG_UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+#else
+#define OLOG_UNLIKELY(condition) (condition)
+#endif
+
+/*
+ * 是否在链接时收集 OLOG 调用点的静态信息。需要 ELF 目标文件，
+ * 且静态信息的地址在链接时确定，即编译可执行文件（包括 PIE），
+ * 而不是共享库中的位置无关代码。不满足时在第一次执行调用点时注册。
+ * Logger 只能遍历它所在模块的 olog_static_info 段，olog 编译为共享库时
+ * 由构建定义 OLOG_NO_LINK_TIME_REGISTRATION 关闭。
+ */
+#if !defined(OLOG_NO_LINK_TIME_REGISTRATION) && defined(__GNUC__) &&          \
+    defined(__ELF__) &&                                                        \
+    (defined(__x86_64__) || defined(__aarch64__)) &&                           \
+    (!defined(__PIC__) || defined(__PIE__))
+#define OLOG_LINK_TIME_REGISTRATION
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,214 @@
+#ifndef OLOG_RATE_LIMIT_H
+#define OLOG_RATE_LIMIT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "buffers.h"
+#include "olog_config.h"
+#include "utils.h"
+
+namespace olog {
+
+/**
+ * rate_limit 命名空间下定义了 OLOG_EVERY_N 等宏在每个调用点静态存储的
+ * 限流状态。每个状态都对齐到缓存行，不会与其他调用点的状态共享缓存行。
+ *
+ * 限流器的 shouldLog 决定本次是否写出日志，返回 true 时通过 num_suppressed
+ * 给出自上次写出以来被跳过的次数。只有通过了调用点状态和日志等级检查的调用
+ * 才会经过限流器。
+ */
+namespace rate_limit {
+
+/**
+ * @brief
+ * 获取当前线程所使用的计数分片。线程第一次调用时依次分配。
+ *
+ * @return uint32_t
+ */
+inline uint32_t GetThreadShard() {
+    static std::atomic<uint32_t> next_shard{0};
+    thread_local uint32_t shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed) %
+        config::RATE_LIMIT_COUNTER_SHARDS;
+    return shard;
+}
+
+/**
+ * @brief
+ * 被跳过的日志的计数。计数按线程分散到多个缓存行中，
+ * 多个线程同时跳过同一调用点的日志时通常不会争用同一个缓存行。
+ */
+class SuppressedCounter {
+  public:
+    constexpr SuppressedCounter() = default;
+
+    inline void add() {
+        shards_[GetThreadShard()].count_.fetch_add(1,
+                                                   std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief
+     * 取出所有分片中的计数并清零。
+     *
+     * @return uint64_t
+     */
+    inline uint64_t take() {
+        uint64_t total = 0;
+        for (Shard& shard : shards_)
+            total += shard.count_.exchange(0, std::memory_order_relaxed);
+        return total;
+    }
+
+  private:
+    struct alignas(buffers::CACHE_LINE_SIZE) Shard {
+        std::atomic<uint64_t> count_{0};
+    };
+
+    Shard shards_[config::RATE_LIMIT_COUNTER_SHARDS];
+};
+
+/**
+ * @brief
+ * 每 n 次调用写出一次，从第一次调用开始。
+ * 为了准确计数，每次调用都会修改同一个计数器。
+ */
+class alignas(buffers::CACHE_LINE_SIZE) EveryN {
+  public:
+    /**
+     * @param n 小于 1 时视为 1。
+     */
+    constexpr explicit EveryN(uint64_t n) : n_(n > 0 ? n : 1), count_(0) {}
+
+    inline bool shouldLog(uint64_t& num_suppressed) {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (count % n_ != 0)
+            return false;
+        num_suppressed = count == 0 ? 0 : n_ - 1;
+        return true;
+    }
+
+  private:
+    const uint64_t n_;
+
+    std::atomic<uint64_t> count_;
+};
+
+/**
+ * @brief
+ * 只写出前 n 次调用。之后的调用只读取计数器，不再修改它。
+ * 被跳过的日志之后不会再有写出的机会，所以不报告被跳过的次数。
+ */
+class alignas(buffers::CACHE_LINE_SIZE) FirstN {
+  public:
+    constexpr explicit FirstN(uint64_t n) : n_(n), count_(0) {}
+
+    inline bool shouldLog(uint64_t& num_suppressed) {
+        num_suppressed = 0;
+        if (count_.load(std::memory_order_relaxed) >= n_)
+            return false;
+        return count_.fetch_add(1, std::memory_order_relaxed) < n_;
+    }
+
+  private:
+    const uint64_t n_;
+
+    std::atomic<uint64_t> count_;
+};
+
+/**
+ * @brief
+ * 两次写出之间至少间隔 interval_ns 纳秒。
+ * 同一时刻有多个线程到达时只有一个线程写出。
+ */
+class alignas(buffers::CACHE_LINE_SIZE) EveryInterval {
+  public:
+    constexpr explicit EveryInterval(int64_t interval_ns)
+        : interval_ns_(interval_ns), next_ns_(0) {}
+
+    inline bool shouldLog(uint64_t& num_suppressed) {
+        return shouldLog(num_suppressed, utils::GetNsSteadyClockInterval());
+    }
+
+    /**
+     * @param now_ns 当前单调时钟的纳秒数。
+     */
+    inline bool shouldLog(uint64_t& num_suppressed, int64_t now_ns) {
+        int64_t next_ns = next_ns_.load(std::memory_order_relaxed);
+        if (now_ns < next_ns ||
+            !next_ns_.compare_exchange_strong(next_ns, now_ns + interval_ns_,
+                                              std::memory_order_relaxed)) {
+            suppressed_.add();
+            return false;
+        }
+        num_suppressed = suppressed_.take();
+        return true;
+    }
+
+  private:
+    const int64_t interval_ns_;
+
+    // 下一次可以写出的时间。
+    std::atomic<int64_t> next_ns_;
+
+    SuppressedCounter suppressed_;
+};
+
+/**
+ * @brief
+ * 令牌桶：平均每秒最多写出 rate 次，最多连续写出 burst 次。
+ * 以 GCRA 的方式实现，整个桶只有一个原子变量：
+ * 理论到达时间每写出一次向后推迟 1 / rate 秒，
+ * 超出当前时间 (burst - 1) / rate 秒以上时说明令牌已经用完。
+ */
+class alignas(buffers::CACHE_LINE_SIZE) TokenBucket {
+  public:
+    /**
+     * @param rate 每秒补充的令牌数，小于 1 时视为 1。
+     * @param burst 桶的容量，小于 1 时视为 1。
+     */
+    constexpr TokenBucket(uint64_t rate, uint64_t burst)
+        : emission_interval_ns_(1000 * 1000 * 1000 /
+                                static_cast<int64_t>(rate > 0 ? rate : 1)),
+          tolerance_ns_(emission_interval_ns_ *
+                        static_cast<int64_t>(burst > 0 ? burst - 1 : 0)),
+          theoretical_arrival_ns_(0) {}
+
+    inline bool shouldLog(uint64_t& num_suppressed) {
+        return shouldLog(num_suppressed, utils::GetNsSteadyClockInterval());
+    }
+
+    /**
+     * @param now_ns 当前单调时钟的纳秒数。
+     */
+    inline bool shouldLog(uint64_t& num_suppressed, int64_t now_ns) {
+        int64_t arrival_ns =
+            theoretical_arrival_ns_.load(std::memory_order_relaxed);
+        do {
+            if (arrival_ns - tolerance_ns_ > now_ns) {
+                suppressed_.add();
+                return false;
+            }
+        } while (!theoretical_arrival_ns_.compare_exchange_weak(
+            arrival_ns, std::max(arrival_ns, now_ns) + emission_interval_ns_,
+            std::memory_order_relaxed));
+        num_suppressed = suppressed_.take();
+        return true;
+    }
+
+  private:
+    const int64_t emission_interval_ns_;
+
+    const int64_t tolerance_ns_;
+
+    std::atomic<int64_t> theoretical_arrival_ns_;
+
+    SuppressedCounter suppressed_;
+};
+
+}  // namespace rate_limit
+}  // namespace olog
+
+#endif
@@ -0,0 +1,77 @@
+#include "registry.h"
+
+#include <cassert>
+#include <new>
+
+#include "utils.h"
+
+namespace olog {
+namespace registry {
+
+StaticInfoRegistry::StaticInfoRegistry() : num_allocated_(0) {
+    for (std::atomic<Slot*>& segment : segments_)
+        segment.store(nullptr, std::memory_order_relaxed);
+}
+
+StaticInfoRegistry::~StaticInfoRegistry() {
+    for (std::atomic<Slot*>& segment : segments_)
+        delete[] segment.load(std::memory_order_relaxed);
+}
+
+size_t StaticInfoRegistry::add(const log_info::StaticLogInfo& static_info) {
+    size_t id = num_allocated_.fetch_add(1, std::memory_order_acq_rel);
+    Slot* slot = getSlot(id, true);
+    new (slot->storage_) log_info::StaticLogInfo(static_info);
+    slot->published_.store(true, std::memory_order_release);
+    return id;
+}
+
+bool StaticInfoRegistry::isPublished(size_t id) const {
+    const Slot* slot = getSlot(id, false);
+    return slot != nullptr && slot->published_.load(std::memory_order_acquire);
+}
+
+const log_info::StaticLogInfo& StaticInfoRegistry::get(size_t id) const {
+    assert(id < size());
+    // 注册线程可能还在分配段或写入静态信息。
+    const Slot* slot = nullptr;
+    while ((slot = getSlot(id, false)) == nullptr)
+        utils::CpuRelax();
+    while (!slot->published_.load(std::memory_order_acquire))
+        utils::CpuRelax();
+    return *std::launder(
+        reinterpret_cast<const log_info::StaticLogInfo*>(slot->storage_));
+}
+
+size_t StaticInfoRegistry::locate(size_t id, size_t& offset) {
+    // 第 k 段之前共有 FIRST_SEGMENT_SIZE * (2^k - 1) 个位置。
+    size_t index = id / config::REGISTRY_FIRST_SEGMENT_SIZE + 1;
+    size_t segment = 63 - __builtin_clzll(index);
+    offset = id - config::REGISTRY_FIRST_SEGMENT_SIZE * ((1ULL << segment) - 1);
+    return segment;
+}
+
+StaticInfoRegistry::Slot* StaticInfoRegistry::getSlot(size_t id,
+                                                       bool allocate) const {
+    size_t offset = 0;
+    size_t segment = locate(id, offset);
+    assert(segment < MAX_SEGMENTS);
+
+    Slot* slots = segments_[segment].load(std::memory_order_acquire);
+    if (slots == nullptr && allocate) {
+        Slot* new_slots =
+            new Slot[config::REGISTRY_FIRST_SEGMENT_SIZE << segment];
+        if (segments_[segment].compare_exchange_strong(
+                slots, new_slots, std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+            slots = new_slots;
+        } else {
+            // 其他线程已经分配了这个段。
+            delete[] new_slots;
+        }
+    }
+    return slots == nullptr ? nullptr : slots + offset;
+}
+
+}  // namespace registry
+}  // namespace olog
@@ -0,0 +1,123 @@
+#ifndef OLOG_REGISTRY_H
+#define OLOG_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "log_info.h"
+#include "olog_config.h"
+
+namespace olog {
+
+/**
+ * registry 命名空间下定义了保存已注册日志静态信息的注册表。
+ */
+namespace registry {
+
+/**
+ * @brief
+ * 只追加的日志静态信息注册表，注册和读取都不加锁。
+ *
+ * 注册表由一组大小依次翻倍的段组成，第 k 段有
+ * REGISTRY_FIRST_SEGMENT_SIZE << k 个位置。段一旦分配就不再移动或释放，
+ * 所以 id 和静态信息的地址在注册表的整个生命期内保持不变，
+ * 日志线程可以直接使用，不需要副本。
+ *
+ * 注册时先以原子操作分配 id，将静态信息写入对应的位置后再以 release
+ * 语义发布该位置。读取时以 acquire 语义检查位置是否已发布。
+ */
+class StaticInfoRegistry {
+  public:
+    StaticInfoRegistry();
+
+    ~StaticInfoRegistry();
+
+    StaticInfoRegistry(const StaticInfoRegistry&) = delete;
+
+    StaticInfoRegistry(StaticInfoRegistry&&) = delete;
+
+    /**
+     * @brief
+     * 注册一条静态信息。可以由多个线程同时调用。
+     *
+     * @param static_info
+     * @return 分配的 id，从 0 开始连续分配。
+     */
+    size_t add(const log_info::StaticLogInfo& static_info);
+
+    /**
+     * @brief
+     * 获取已分配的 id 的数量，其中可能有尚未发布的 id。
+     *
+     * @return size_t
+     */
+    inline size_t size() const {
+        return num_allocated_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief
+     * 检查 id 对应的静态信息是否已经发布。
+     *
+     * @param id 小于 size() 的 id。
+     * @return bool
+     */
+    bool isPublished(size_t id) const;
+
+    /**
+     * @brief
+     * 获取 id 对应的静态信息。该 id 尚未发布时等待注册它的线程完成发布，
+     * 通常只有写入一条静态信息的时间。
+     *
+     * @param id 小于 size() 的 id。
+     * @return const log_info::StaticLogInfo&
+     */
+    const log_info::StaticLogInfo& get(size_t id) const;
+
+  private:
+    struct Slot {
+        alignas(log_info::StaticLogInfo) char
+            storage_[sizeof(log_info::StaticLogInfo)];
+
+        std::atomic<bool> published_{false};
+    };
+
+    static_assert(std::is_trivially_destructible_v<log_info::StaticLogInfo>,
+                  "StaticLogInfo in a registry slot is never destructed");
+
+    // 段的数量上限，足以容纳 int 能表示的全部 id。
+    static constexpr size_t MAX_SEGMENTS = 32;
+
+    /**
+     * @brief
+     * 计算 id 所在的段和段内的位置。
+     *
+     * @param id
+     * @param offset 段内的位置。
+     * @return 段的序号。
+     */
+    static size_t locate(size_t id, size_t& offset);
+
+    /**
+     * @brief
+     * 获取 id 对应的位置。所在的段尚未分配时，由 allocate 为 true
+     * 的调用分配，多个线程同时分配时只保留一个。
+     *
+     * @param id
+     * @param allocate
+     * @return 位置。段尚未分配且 allocate 为 false 时返回 nullptr。
+     */
+    Slot* getSlot(size_t id, bool allocate) const;
+
+  private:
+    mutable std::atomic<Slot*> segments_[MAX_SEGMENTS];
+
+    std::atomic<size_t> num_allocated_;
+};
+
+}  // namespace registry
+}  // namespace olog
+
+#endif
@@ -1 +1,89 @@
-#include "utils.h"
\ No newline at end of file
+#include "utils.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <limits>
+
+#include "olog_config.h"
+
+namespace olog {
+namespace utils {
+
+TscClock::TscClock() : first_tsc_(0), first_raw_ns_(0), calibration_() {
+    int64_t ns = 0;
+    Sample(first_tsc_, first_raw_ns_, ns);
+
+    uint64_t tsc = 0;
+    int64_t raw_ns = 0;
+    do {
+        Sample(tsc, raw_ns, ns);
+    } while (raw_ns - first_raw_ns_ < config::TSC_INITIAL_CALIBRATION_NS);
+
+    calibration_.tsc_base_ = tsc;
+    calibration_.ns_base_ = ns;
+    if (tsc > first_tsc_)
+        calibration_.ns_per_tick_ =
+            static_cast<double>(raw_ns - first_raw_ns_) / (tsc - first_tsc_);
+}
+
+void TscClock::recalibrate() {
+    uint64_t tsc = 0;
+    int64_t raw_ns = 0;
+    int64_t ns = 0;
+    Sample(tsc, raw_ns, ns);
+
+    // 频率只由单调时钟计算，系统时钟的调整只移动基准点。
+    if (tsc > first_tsc_ && raw_ns > first_raw_ns_)
+        calibration_.ns_per_tick_ =
+            static_cast<double>(raw_ns - first_raw_ns_) / (tsc - first_tsc_);
+    calibration_.tsc_base_ = tsc;
+    calibration_.ns_base_ = ns;
+}
+
+bool TscClock::recalibrateIfNeeded(int64_t interval_ns) {
+    uint64_t elapsed_ticks = ReadTsc() - calibration_.tsc_base_;
+    if (static_cast<double>(elapsed_ticks) * calibration_.ns_per_tick_ <
+        static_cast<double>(interval_ns))
+        return false;
+    recalibrate();
+    return true;
+}
+
+void TscClock::Sample(uint64_t& tsc, int64_t& raw_ns, int64_t& ns) {
+    uint64_t min_cost = std::numeric_limits<uint64_t>::max();
+    for (int i = 0; i < 5; ++i) {
+        uint64_t before = ReadTsc();
+        int64_t raw_now = GetNsMonotonicRawClockInterval();
+        int64_t now = GetNsSystemClockInterval();
+        uint64_t after = ReadTsc();
+        if (after - before < min_cost) {
+            min_cost = after - before;
+            tsc = before + (after - before) / 2;
+            raw_ns = raw_now;
+            ns = now;
+        }
+    }
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex requires a plain 32-bit word");
+
+void FutexWait(std::atomic<uint32_t>& word, uint32_t expected,
+               int64_t timeout_ns) {
+    timespec timeout;
+    timeout.tv_sec = timeout_ns / 1000000000;
+    timeout.tv_nsec = timeout_ns % 1000000000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+            expected, &timeout, nullptr, 0);
+}
+
+void FutexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+            1, nullptr, nullptr, 0);
+}
+
+}  // namespace utils
+}  // namespace olog
@@ -1,8 +1,14 @@
 #ifndef OLOG_UTILS_H
 #define OLOG_UTILS_H
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace olog {
 namespace utils {
@@ -19,7 +25,189 @@ inline int64_t GetMsSystemClockInterval() {
         .count();
 }
 
+/**
+ * @brief
+ * 获取系统使用的时钟自开始到现在所经过的纳秒数。
+ *
+ * @return int64_t
+ */
+inline int64_t GetNsSystemClockInterval() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief
+ * 获取单调时钟自开始到现在所经过的纳秒数，不受系统时间调整的影响。
+ *
+ * @return int64_t
+ */
+inline int64_t GetNsSteadyClockInterval() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief
+ * 获取 CLOCK_MONOTONIC_RAW 自开始到现在所经过的纳秒数。
+ * 既不受系统时间调整的影响，也不受 NTP 对频率的微调影响，
+ * 适合用来测量计数器的频率。
+ *
+ * @return int64_t
+ */
+inline int64_t GetNsMonotonicRawClockInterval() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000 * 1000 * 1000 +
+           now.tv_nsec;
+}
+
+/**
+ * @brief
+ * 读取 CPU 的时间戳计数器。x86 上使用 rdtsc，aarch64 上读取 cntvct_el0，
+ * 其他平台退化为单调时钟的纳秒数。
+ * 计数器的值需要经过 TscCalibration 才能转换为时间。
+ *
+ * @return uint64_t
+ */
+inline uint64_t ReadTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t tsc;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(tsc));
+    return tsc;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/**
+ * @brief
+ * 提示 CPU 当前处于自旋等待中，降低自旋的功耗以及对同一核心上
+ * 其他超线程的影响。
+ */
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * @brief
+ * word 的值等于 expected 时休眠，直到被 FutexWake 唤醒或超时。
+ * 值不等于 expected 时立即返回。可能发生虚假唤醒，调用者需要重新检查条件。
+ *
+ * @param word 等待的变量。
+ * @param expected 期望的值。
+ * @param timeout_ns 最长的休眠时间（纳秒）。
+ */
+void FutexWait(std::atomic<uint32_t>& word, uint32_t expected,
+               int64_t timeout_ns);
+
+/**
+ * @brief
+ * 唤醒一个在 word 上休眠的线程。
+ *
+ * @param word 等待的变量。
+ */
+void FutexWake(std::atomic<uint32_t>& word);
+
+/**
+ * @brief
+ * 时间戳计数器到系统时钟的线性映射。
+ * 默认值将计数器的值直接视为系统时钟的纳秒数。
+ */
+struct TscCalibration {
+    // 校准时采样的计数器的值。
+    uint64_t tsc_base_ = 0;
+
+    // 与 tsc_base_ 同时采样的系统时钟的纳秒数。
+    int64_t ns_base_ = 0;
+
+    // 计数器每增加 1 所经过的纳秒数。
+    double ns_per_tick_ = 1.0;
+
+    /**
+     * @brief 将计数器的值转换为系统时钟的纳秒数。
+     *
+     * @param tsc 计数器的值，可以早于 tsc_base_。
+     * @return int64_t
+     */
+    inline int64_t toNs(uint64_t tsc) const {
+        int64_t ticks = static_cast<int64_t>(tsc - tsc_base_);
+        return ns_base_ +
+               static_cast<int64_t>(static_cast<double>(ticks) * ns_per_tick_);
+    }
+};
+
+/**
+ * @brief
+ * TscClock 维护时间戳计数器与系统时钟之间的校准。
+ * 计数器的频率由构造时的采样与最近一次采样之间 CLOCK_MONOTONIC_RAW 的
+ * 间隔计算，间隔越长频率越准确，系统时钟被调整时也不受影响；
+ * 系统时钟只用作映射的基准点。每次重新校准时基准点移动到最近的采样，
+ * 从而跟随系统时钟的调整。
+ * TscClock 不是线程安全的，由日志线程独占使用。
+ */
+class TscClock {
+  public:
+    /**
+     * @brief
+     * 进行初始校准。为了得到可用的初始频率，构造函数会忙等待一小段时间。
+     */
+    TscClock();
+
+    ~TscClock() = default;
+
+    TscClock(const TscClock&) = delete;
+
+    TscClock(TscClock&&) = delete;
+
+    /**
+     * @brief 立即使用新的采样重新校准。
+     */
+    void recalibrate();
+
+    /**
+     * @brief 距离上一次校准超过 interval_ns 纳秒时重新校准。
+     *
+     * @param interval_ns 校准的间隔。
+     * @return 进行了校准时返回 true。
+     */
+    bool recalibrateIfNeeded(int64_t interval_ns);
+
+    inline const TscCalibration& getCalibration() const {
+        return calibration_;
+    }
+
+  private:
+    /**
+     * @brief
+     * 同时采样计数器、CLOCK_MONOTONIC_RAW 与系统时钟。
+     * 多次采样并选取读取时钟耗时最短的一次，计数器取读取前后的中点。
+     *
+     * @param tsc 计数器的值。
+     * @param raw_ns CLOCK_MONOTONIC_RAW 的纳秒数。
+     * @param ns 系统时钟的纳秒数。
+     */
+    static void Sample(uint64_t& tsc, int64_t& raw_ns, int64_t& ns);
+
+  private:
+    // 构造时的采样，用于计算频率。
+    uint64_t first_tsc_;
+    int64_t first_raw_ns_;
+
+    TscCalibration calibration_;
+};
+
 }  // namespace utils
 }  // namespace olog
 
-#endif
\ No newline at end of file
+#endif
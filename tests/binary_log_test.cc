@@ -0,0 +1,180 @@
+#include "binary_log.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <string>
+
+using namespace olog::log_info;
+using namespace olog::binary_log;
+
+namespace {
+
+constexpr char FORMAT[] = "int: %d, str: %s, double: %.2lf, padded: %*u";
+constexpr size_t NUM_PARAMS = FormatParametersCount(FORMAT);
+constexpr size_t NUM_CONVERSIONS = ConversionSpecifiersCount(FORMAT);
+constexpr size_t STORAGE_SIZE = SizeConversionStorageNeeds(FORMAT);
+constexpr auto PARAM_TYPES = AnalyzeFormatParameters<NUM_PARAMS>(FORMAT);
+constexpr auto CONVERSION_STORAGE = MakeConversionStorage<STORAGE_SIZE>(FORMAT);
+constexpr auto FORMAT_FRAGMENTS =
+    GetFormatFragments<NUM_CONVERSIONS, STORAGE_SIZE>(FORMAT,
+                                                      CONVERSION_STORAGE);
+
+/**
+ * @brief 以 olog::Log 相同的方式将实参存储为一条动态信息。
+ */
+template <typename... _Args>
+size_t MakeDynamicInfo(char* dst, size_t log_id, uint64_t timestamp,
+                       _Args... args) {
+    size_t string_sizes[NUM_PARAMS + 1];
+    size_t pre_precision = 0;
+    size_t alloc_size =
+        GetArgSizes(PARAM_TYPES, string_sizes, pre_precision, args...) +
+        sizeof(DynamicLogInfo);
+    DynamicLogInfo* dynamic_info = new (dst) DynamicLogInfo();
+    dynamic_info->log_id_ = log_id;
+    dynamic_info->info_size_ = alloc_size;
+    dynamic_info->timestamp_ = timestamp;
+    char* write_pos = dst + sizeof(DynamicLogInfo);
+    StoreArguments(write_pos, PARAM_TYPES, string_sizes, args...);
+    return alloc_size;
+}
+
+std::string Assemble(const StaticLogInfo* static_info,
+                     const DynamicLogInfo* dynamic_info, size_t producer_id) {
+    char buffer[512];
+    LogAssembler log_assembler;
+    log_assembler.setBuffer(buffer, sizeof(buffer));
+    log_assembler.loadLogInfo(static_info, dynamic_info, producer_id);
+    while (log_assembler.hasRemainingData())
+        log_assembler.write();
+    return std::string(buffer, log_assembler.getWritedBytes());
+}
+
+/**
+ * @brief 使用很小的缓冲区写出条目，确保条目会被拆分。
+ */
+void WriteAll(BinaryLogWriter& writer, std::string& output) {
+    char buffer[7];
+    writer.setBuffer(buffer, sizeof(buffer));
+    while (writer.hasRemainingData()) {
+        writer.write();
+        if (writer.isBufferFull()) {
+            output.append(buffer, writer.getWritedBytes());
+            writer.setBuffer(buffer, sizeof(buffer));
+        }
+    }
+    output.append(buffer, writer.getWritedBytes());
+}
+
+}  // namespace
+
+TEST_CASE("Write and read back binary logs", "[BinaryLogWriter]") {
+    constexpr auto param_sizes = MakeParamSizes(
+        PARAM_TYPES, decltype(ArgTypes(42, "hello", 3.14159, 8, 17u))());
+    StaticLogInfo static_info("binary_log_test.cc", 23, LogLevel::WARNING,
+                              sizeof(FORMAT), NUM_CONVERSIONS, NUM_PARAMS,
+                              FORMAT, CONVERSION_STORAGE.data(),
+                              FORMAT_FRAGMENTS.data(), PARAM_TYPES.data(),
+                              param_sizes.data());
+
+    alignas(DynamicLogInfo) char record0[256];
+    alignas(DynamicLogInfo) char record1[256];
+    MakeDynamicInfo(record0, 0, 1700000000123456789, 42, "hello", 3.14159, 8,
+                    17u);
+    MakeDynamicInfo(record1, 0, 1700000001456000000, -7, "a longer string", 2.5,
+                    3, 123456u);
+    const DynamicLogInfo* dynamic0 =
+        reinterpret_cast<const DynamicLogInfo*>(record0);
+    const DynamicLogInfo* dynamic1 =
+        reinterpret_cast<const DynamicLogInfo*>(record1);
+
+    std::string file_content;
+    BinaryLogWriter writer;
+    writer.loadFileHeader();
+    WriteAll(writer, file_content);
+    writer.loadStaticInfo(0, &static_info);
+    WriteAll(writer, file_content);
+    writer.loadDynamicInfo(dynamic0, 3);
+    WriteAll(writer, file_content);
+    olog::utils::TscCalibration calibration;
+    calibration.tsc_base_ = 123456;
+    calibration.ns_base_ = 1700000000000000000;
+    calibration.ns_per_tick_ = 0.4;
+    writer.loadCalibration(calibration);
+    WriteAll(writer, file_content);
+    writer.loadDynamicInfo(dynamic1, 5);
+    WriteAll(writer, file_content);
+
+    FILE* input =
+        fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    BinaryLogReader reader(input);
+
+    REQUIRE(reader.next());
+    REQUIRE(reader.getProducerId() == 3);
+    REQUIRE(strcmp(reader.getStaticInfo()->filename_, "binary_log_test.cc") ==
+            0);
+    REQUIRE(Assemble(reader.getStaticInfo(), reader.getDynamicInfo(),
+                     reader.getProducerId()) ==
+            Assemble(&static_info, dynamic0, 3));
+
+    REQUIRE(reader.getCalibration().ns_per_tick_ == 1.0);
+
+    REQUIRE(reader.next());
+    REQUIRE(reader.getProducerId() == 5);
+    REQUIRE(reader.getCalibration().tsc_base_ == calibration.tsc_base_);
+    REQUIRE(reader.getCalibration().ns_base_ == calibration.ns_base_);
+    REQUIRE(reader.getCalibration().ns_per_tick_ == calibration.ns_per_tick_);
+    REQUIRE(Assemble(reader.getStaticInfo(), reader.getDynamicInfo(),
+                     reader.getProducerId()) ==
+            Assemble(&static_info, dynamic1, 5));
+
+    REQUIRE_FALSE(reader.next());
+    fclose(input);
+}
+
+TEST_CASE("Truncated binary log stops at the last complete entry",
+          "[BinaryLogReader]") {
+    constexpr auto param_sizes = MakeParamSizes(
+        PARAM_TYPES, decltype(ArgTypes(42, "hello", 3.14159, 8, 17u))());
+    StaticLogInfo static_info("binary_log_test.cc", 23, LogLevel::INFO,
+                              sizeof(FORMAT), NUM_CONVERSIONS, NUM_PARAMS,
+                              FORMAT, CONVERSION_STORAGE.data(),
+                              FORMAT_FRAGMENTS.data(), PARAM_TYPES.data(),
+                              param_sizes.data());
+
+    alignas(DynamicLogInfo) char record[256];
+    MakeDynamicInfo(record, 0, 1700000000123456789, 42, "hello", 3.14159, 8,
+                    17u);
+
+    std::string file_content;
+    BinaryLogWriter writer;
+    writer.loadFileHeader();
+    WriteAll(writer, file_content);
+    writer.loadStaticInfo(0, &static_info);
+    WriteAll(writer, file_content);
+    writer.loadDynamicInfo(reinterpret_cast<const DynamicLogInfo*>(record), 0);
+    WriteAll(writer, file_content);
+    writer.loadDynamicInfo(reinterpret_cast<const DynamicLogInfo*>(record), 0);
+    WriteAll(writer, file_content);
+
+    // 丢弃最后一个条目的尾部。
+    file_content.resize(file_content.size() - 3);
+
+    FILE* input =
+        fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    BinaryLogReader reader(input);
+    REQUIRE(reader.next());
+    REQUIRE_FALSE(reader.next());
+    fclose(input);
+}
+
+TEST_CASE("Reject files without header", "[BinaryLogReader]") {
+    char content[] = "2024-01-01 00:00:00.000 main.cc:1 [INFO][0]: text log";
+    FILE* input = fmemopen(content, sizeof(content), "rb");
+    REQUIRE(input != nullptr);
+    BinaryLogReader reader(input);
+    REQUIRE_THROWS(reader.next());
+    fclose(input);
+}
@@ -121,4 +121,30 @@ TEST_CASE("Should not be destruct after incomplete consumption", "[StagingBuffer
 
     REQUIRE_FALSE(bytes_pipe->shouldBeDestructed());
     delete bytes_pipe;
-}
\ No newline at end of file
+}
+TEST_CASE("Count dropped records", "[StagingBuffer]") {
+    const size_t BYTES_PIPE_CAPACITY = 64;
+    StagingBuffer::DestructGuard guard;
+    StagingBuffer bytes_pipe(0, BYTES_PIPE_CAPACITY, guard);
+    REQUIRE(bytes_pipe.takeDroppedRecords() == 0);
+
+    char* write_pos = bytes_pipe.reserveProducerSpace(48, false);
+    REQUIRE(write_pos != nullptr);
+    bytes_pipe.finishReservation(48);
+
+    // 剩余空间不足，非阻塞的分配会失败。
+    REQUIRE(bytes_pipe.reserveProducerSpace(32, false) == nullptr);
+    bytes_pipe.addDroppedRecord();
+    bytes_pipe.addDroppedRecord();
+    REQUIRE(bytes_pipe.takeDroppedRecords() == 2);
+    REQUIRE(bytes_pipe.takeDroppedRecords() == 0);
+
+    size_t available_bytes = 0;
+    bytes_pipe.peek(available_bytes);
+    REQUIRE(available_bytes == 48);
+    bytes_pipe.consume(available_bytes);
+    REQUIRE(bytes_pipe.reserveProducerSpace(32, false) != nullptr);
+
+    bytes_pipe.addDroppedRecord();
+    REQUIRE(bytes_pipe.takeDroppedRecords() == 1);
+}
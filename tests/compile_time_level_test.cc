@@ -0,0 +1,20 @@
+// 比 WARNING 更详细的日志在编译期被丢弃。
+#define OLOG_COMPILE_TIME_MIN_LEVEL WARNING
+
+#include "olog.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("OLOG below the compile-time level is discarded", "[OLOG]") {
+    STATIC_REQUIRE_FALSE(OLOG_IS_COMPILED_IN(LogLevel::INFO));
+    STATIC_REQUIRE(OLOG_IS_COMPILED_IN(LogLevel::WARNING));
+
+    // 被丢弃的 OLOG 不会对参数求值。
+    int a = 0;
+    OLOG(LogLevel::DEBUG, "val: %d", ++a);
+    OLOG(LogLevel::INFO, "val: %d", ++a);
+    REQUIRE(a == 0);
+    OLOG(LogLevel::WARNING, "val: %d", ++a);
+    OLOG(LogLevel::ERROR, "val: %d", ++a);
+    REQUIRE(a == 2);
+}
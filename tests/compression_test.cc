@@ -0,0 +1,180 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace olog::compression;
+
+namespace {
+
+/**
+ * @brief 将连续相同的字节编码为（次数，字节）的简单压缩器。
+ */
+class RunLengthCompressor : public Compressor {
+  public:
+    static constexpr uint8_t CODEC = 200;
+
+    uint8_t getCodec() const override { return CODEC; }
+
+    size_t compress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override {
+        size_t dst_size = 0;
+        for (size_t pos = 0; pos < nbytes;) {
+            size_t run = 1;
+            while (pos + run < nbytes && run < 255 &&
+                   src[pos + run] == src[pos])
+                ++run;
+            if (dst_size + 2 > capacity)
+                return 0;
+            dst[dst_size++] = static_cast<char>(run);
+            dst[dst_size++] = src[pos];
+            pos += run;
+        }
+        return dst_size;
+    }
+
+    bool decompress(const char* src, size_t nbytes, char* dst,
+                    size_t capacity) override {
+        size_t dst_size = 0;
+        for (size_t pos = 0; pos + 1 < nbytes; pos += 2) {
+            size_t run = static_cast<unsigned char>(src[pos]);
+            if (dst_size + run > capacity)
+                return false;
+            std::fill_n(dst + dst_size, run, src[pos + 1]);
+            dst_size += run;
+        }
+        return dst_size == capacity;
+    }
+};
+
+/**
+ * @brief 将 data 编码为一个帧并追加到 file_content 末尾。
+ */
+void AppendFrame(Compressor& compressor, const std::string& data,
+                 std::string& file_content) {
+    std::vector<char> frame(GetMaxFrameSize(data.size()));
+    size_t frame_size =
+        EncodeFrame(compressor, data.data(), data.size(), frame.data());
+    REQUIRE(frame_size <= frame.size());
+    file_content.append(frame.data(), frame_size);
+}
+
+}  // namespace
+
+TEST_CASE("Frames round trip through FrameReader", "[FrameReader]") {
+    NoopCompressor noop;
+    RunLengthCompressor run_length;
+    const std::string text = "2024-01-01 00:00:00.000 main.cc:1 [INFO][0]: a\n";
+    const std::string repeated(1000, 'x');
+
+    std::string file_content;
+    AppendFrame(noop, text, file_content);
+    AppendFrame(run_length, repeated, file_content);
+    // 压缩后没有变小的数据以原始数据存储。
+    AppendFrame(run_length, text, file_content);
+    REQUIRE(file_content.size() <
+            3 * sizeof(FrameHeader) + 2 * text.size() + repeated.size());
+
+    FILE* input = fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    FrameReader reader(input);
+    reader.registerCompressor(std::make_unique<RunLengthCompressor>());
+
+    REQUIRE(reader.next());
+    REQUIRE(std::string(reader.getData(), reader.getSize()) == text);
+    REQUIRE(reader.next());
+    REQUIRE(std::string(reader.getData(), reader.getSize()) == repeated);
+    REQUIRE(reader.next());
+    REQUIRE(std::string(reader.getData(), reader.getSize()) == text);
+    REQUIRE_FALSE(reader.next());
+    REQUIRE(reader.isComplete());
+    fclose(input);
+}
+
+TEST_CASE("Truncated file stops at the last complete frame", "[FrameReader]") {
+    NoopCompressor noop;
+    std::string file_content;
+    AppendFrame(noop, "first frame", file_content);
+    AppendFrame(noop, "second frame", file_content);
+
+    SECTION("Truncated payload") {
+        file_content.resize(file_content.size() - 3);
+    }
+    SECTION("Corrupted payload") {
+        file_content.back() ^= 1;
+    }
+    SECTION("Unwritten tail") {
+        file_content.resize(file_content.size() - 12);
+        file_content.append(4096, '\0');
+    }
+
+    FILE* input = fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    FrameReader reader(input);
+    REQUIRE(reader.next());
+    REQUIRE(std::string(reader.getData(), reader.getSize()) == "first frame");
+    REQUIRE_FALSE(reader.next());
+    REQUIRE_FALSE(reader.isComplete());
+    fclose(input);
+}
+
+TEST_CASE("Unknown codec is rejected", "[FrameReader]") {
+    RunLengthCompressor run_length;
+    std::string file_content;
+    AppendFrame(run_length, std::string(100, 'y'), file_content);
+
+    FILE* input = fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    FrameReader reader(input);
+    REQUIRE_FALSE(reader.next());
+    REQUIRE_FALSE(reader.isComplete());
+    fclose(input);
+}
+
+TEST_CASE("CompressionWorker returns jobs in submission order",
+          "[CompressionWorker]") {
+    constexpr size_t NUM_JOBS = 16;
+    std::vector<std::string> inputs;
+    std::vector<std::vector<char>> frames;
+    for (size_t i = 0; i < NUM_JOBS; ++i) {
+        inputs.push_back(std::string(i * 100 + 1, static_cast<char>('a' + i)));
+        frames.emplace_back(GetMaxFrameSize(inputs.back().size()));
+    }
+
+    CompressionWorker worker([] {});
+    worker.setCompressor(std::make_unique<RunLengthCompressor>());
+    REQUIRE_FALSE(worker.hasPendingJobs());
+    for (size_t i = 0; i < NUM_JOBS; ++i)
+        worker.submit(i, inputs[i].data(), inputs[i].size(), frames[i].data());
+    REQUIRE(worker.hasPendingJobs());
+
+    std::string file_content;
+    for (size_t i = 0; i < NUM_JOBS; ++i) {
+        size_t id = 0;
+        size_t frame_size = 0;
+        REQUIRE(worker.takeFinished(id, frame_size, true));
+        REQUIRE(id == i);
+        file_content.append(frames[i].data(), frame_size);
+    }
+    REQUIRE_FALSE(worker.hasPendingJobs());
+
+    size_t id = 0;
+    size_t frame_size = 0;
+    REQUIRE_FALSE(worker.takeFinished(id, frame_size, true));
+
+    FILE* input = fmemopen(file_content.data(), file_content.size(), "rb");
+    REQUIRE(input != nullptr);
+    FrameReader reader(input);
+    reader.registerCompressor(std::make_unique<RunLengthCompressor>());
+    for (size_t i = 0; i < NUM_JOBS; ++i) {
+        REQUIRE(reader.next());
+        REQUIRE(std::string(reader.getData(), reader.getSize()) == inputs[i]);
+    }
+    REQUIRE_FALSE(reader.next());
+    REQUIRE(reader.isComplete());
+    fclose(input);
+}
@@ -0,0 +1,109 @@
+#include "fast_format.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cfloat>
+#include <climits>
+#include <clocale>
+#include <cstdio>
+#include <string>
+
+using namespace olog::fast_format;
+
+TEST_CASE("Decimal integers", "[FormatSignedDecimal][FormatUnsignedDecimal]") {
+    const int64_t signed_values[] = {0,      1,         -1,        9,
+                                     10,     -10,       99,        100,
+                                     12345,  -987654,   INT32_MAX, INT32_MIN,
+                                     INT64_MAX, INT64_MIN};
+    for (int64_t val : signed_values) {
+        char expected[32], actual[MAX_INTEGER_LENGTH];
+        int len = snprintf(expected, sizeof(expected), "%ld", val);
+        REQUIRE(FormatSignedDecimal(actual, val) == static_cast<size_t>(len));
+        REQUIRE(std::string(actual, len) == expected);
+    }
+
+    const uint64_t unsigned_values[] = {0, 7, 10, 999, 1000, 4294967295ULL,
+                                        10000000000000000000ULL, UINT64_MAX};
+    for (uint64_t val : unsigned_values) {
+        char expected[32], actual[MAX_INTEGER_LENGTH];
+        int len = snprintf(expected, sizeof(expected), "%lu", val);
+        REQUIRE(FormatUnsignedDecimal(actual, val) == static_cast<size_t>(len));
+        REQUIRE(std::string(actual, len) == expected);
+    }
+}
+
+TEST_CASE("Hexadecimal integers", "[FormatHex]") {
+    const uint64_t values[] = {0, 0xf, 0x10, 0xdeadbeef, 0x123456789abcdefULL,
+                               UINT64_MAX};
+    for (uint64_t val : values) {
+        char expected[32], actual[MAX_INTEGER_LENGTH];
+        int len = snprintf(expected, sizeof(expected), "%lx", val);
+        REQUIRE(FormatHex(actual, val, false) == static_cast<size_t>(len));
+        REQUIRE(std::string(actual, len) == expected);
+
+        len = snprintf(expected, sizeof(expected), "%lX", val);
+        REQUIRE(FormatHex(actual, val, true) == static_cast<size_t>(len));
+        REQUIRE(std::string(actual, len) == expected);
+    }
+}
+
+TEST_CASE("Pointers", "[FormatPointer]") {
+    int local = 0;
+    const void* values[] = {nullptr, &local, reinterpret_cast<void*>(0x1),
+                            reinterpret_cast<void*>(UINTPTR_MAX)};
+    for (const void* ptr : values) {
+        char expected[32], actual[MAX_POINTER_LENGTH];
+        int len = snprintf(expected, sizeof(expected), "%p", ptr);
+        REQUIRE(FormatPointer(actual, ptr) == static_cast<size_t>(len));
+        REQUIRE(std::string(actual, len) == expected);
+    }
+}
+
+TEST_CASE("Fixed floating points", "[FormatFixedFloat]") {
+    // 包含需要舍入到偶数以及无法精确表示的值。
+    const double values[] = {0.0,      -0.0,       0.5,  1.5,    2.5,
+                             0.125,    0.375,      3.14, -2.718, 1e-7,
+                             123456.789, 1e20,     -1e300, DBL_MIN, DBL_MAX};
+    for (double val : values) {
+        for (int precision = 0; precision <= 12; ++precision) {
+            char expected[512], actual[512];
+            int len =
+                snprintf(expected, sizeof(expected), "%.*f", precision, val);
+            char* end = FormatFixedFloat(actual, actual + sizeof(actual), val,
+                                         precision);
+            REQUIRE(end != nullptr);
+            REQUIRE(std::string(actual, end) == expected);
+            REQUIRE(end - actual == len);
+        }
+    }
+}
+
+TEST_CASE("Fixed floating points follow LC_NUMERIC", "[FormatFixedFloat]") {
+    // 以 ',' 为小数点的 locale，没有安装时不检查。
+    const char* locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                             "fr_FR.utf8"};
+    bool found = false;
+    for (const char* name : locales) {
+        if (setlocale(LC_NUMERIC, name) != nullptr) {
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+        return;
+
+    char expected[64], actual[64];
+    snprintf(expected, sizeof(expected), "%.*f", 3, 3.14159);
+    char* end = FormatFixedFloat(actual, actual + sizeof(actual), 3.14159, 3);
+    setlocale(LC_NUMERIC, "C");
+    REQUIRE(end != nullptr);
+    REQUIRE(std::string(actual, end) == expected);
+    REQUIRE(std::string(expected) == "3,142");
+}
+
+TEST_CASE("Fixed floating points without enough space", "[FormatFixedFloat]") {
+    char buffer[8];
+    REQUIRE(FormatFixedFloat(buffer, buffer + sizeof(buffer), 123456.789, 6) ==
+            nullptr);
+    REQUIRE(FormatFixedFloat(buffer, buffer + sizeof(buffer), 1.5, 1) !=
+            nullptr);
+}
@@ -1,7 +1,9 @@
 #include "log_info.h"
 
 #include <catch2/catch_test_macros.hpp>
+#include <ctime>
 #include <iostream>
+#include <string>
 
 using namespace olog::log_info;
 
@@ -202,30 +204,65 @@ TEST_CASE("GetFormatFragments", "[GetFormatFragments]") {
         GetFormatFragments<num_fragments, storage_size>(format, storage);
     constexpr std::array<FormatFragment, num_fragments> require{
         FormatFragment{GetConversionType("%17.31Lf"), std::size("%17.31Lf") - 1,
-                       std::size("pad") - 1, 0},
+                       std::size("pad") - 1, 0, FastFormat::NONE, 31},
         FormatFragment{GetConversionType("%17.31lc"), std::size("%17.31lc") - 1,
                        std::size("pad%17.31Lfng, pad") - 1,
-                       std::size("%17.31Lf")},
+                       std::size("%17.31Lf"), FastFormat::NONE, 31},
         FormatFragment{GetConversionType("%17.31llu"),
                        std::size("%17.31llu") - 1,
                        std::size("pad%17.31Lfng, pad%17.31lcing,pad") - 1,
-                       std::size("%17.31Lf\0%17.31lc")},
+                       std::size("%17.31Lf\0%17.31lc"), FastFormat::NONE, 31},
         FormatFragment{
             {GetConversionType("%*.*lu")},
             std::size("%*.*lu") - 1,
             std::size("pad%17.31Lfng, pad%17.31lcing,pad%17.31lluing") - 1,
-            std::size("%17.31Lf\0%17.31lc\0%17.31llu")}};
+            std::size("%17.31Lf\0%17.31lc\0%17.31llu"), FastFormat::NONE,
+            -1}};
 
     REQUIRE(format_fragments == require);
 }
 
-TEST_CASE("GetParamSizes", "[GetParamSizes]") {
+TEST_CASE("GetFastFormat", "[GetFastFormat]") {
+    REQUIRE(GetFastFormat("%d") == FastFormat::SIGNED_DECIMAL);
+    REQUIRE(GetFastFormat("%lli") == FastFormat::SIGNED_DECIMAL);
+    REQUIRE(GetFastFormat("%zu") == FastFormat::UNSIGNED_DECIMAL);
+    REQUIRE(GetFastFormat("%hhx") == FastFormat::LOWER_HEX);
+    REQUIRE(GetFastFormat("%lX") == FastFormat::UPPER_HEX);
+    REQUIRE(GetFastFormat("%s") == FastFormat::STRING);
+    REQUIRE(GetFastFormat("%.*s") == FastFormat::STRING);
+    REQUIRE(GetFastFormat("%p") == FastFormat::POINTER);
+    REQUIRE(GetFastFormat("%f") == FastFormat::FIXED_FLOAT);
+    REQUIRE(GetFastFormat("%.3lf") == FastFormat::FIXED_FLOAT);
+
+    REQUIRE(GetFastFormat("%5d") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%-d") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%.3d") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%#x") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%ls") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%.*f") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%Lf") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%e") == FastFormat::NONE);
+    REQUIRE(GetFastFormat("%c") == FastFormat::NONE);
+
+    REQUIRE(GetFastFormat("%%%5d%d", 1) == FastFormat::SIGNED_DECIMAL);
+}
+
+TEST_CASE("GetStaticPrecision", "[GetStaticPrecision]") {
+    REQUIRE(GetStaticPrecision("%f") == -1);
+    REQUIRE(GetStaticPrecision("%.f") == 0);
+    REQUIRE(GetStaticPrecision("%.3f") == 3);
+    REQUIRE(GetStaticPrecision("%17.31Lf") == 31);
+    REQUIRE(GetStaticPrecision("%.*f") == -1);
+    REQUIRE(GetStaticPrecision("%d%.2f", 1) == 2);
+}
+
+TEST_CASE("MakeParamSizes", "[MakeParamSizes]") {
     constexpr char format[] = "|%d|%f|%lf|%s|%x|%u|";
     constexpr size_t num_params = FormatParametersCount(format);
-    auto param_types = AnalyzeFormatParameters<num_params>(format);
-    std::array<size_t, num_params> param_sizes;
-    GetParamSizes(param_types, param_sizes, 10, 3.1415, 9.618, "Hello World",
-                  "This is ptr.", 23);
+    constexpr auto param_types = AnalyzeFormatParameters<num_params>(format);
+    constexpr auto param_sizes = MakeParamSizes(
+        param_types, decltype(ArgTypes(10, 3.1415, 9.618, "Hello World",
+                                       "This is ptr.", 23))());
     REQUIRE(param_sizes == std::array<size_t, num_params>{
                                sizeof(10), sizeof(3.1415), sizeof(9.618), 0,
                                sizeof(void *), sizeof(23)});
@@ -307,4 +344,98 @@ TEST_CASE("Args with const wchar_t*", "[GetArgSizes]") {
                              sizeof(size_t) +
                              wcslen(L"A random string.") * sizeof(wchar_t) + 1);
     REQUIRE(string_sizes[4] == wcslen(L"A random string.") * sizeof(wchar_t));
-}
\ No newline at end of file
+}
+namespace {
+
+/**
+ * @brief 使用 LogAssembler 恢复一条没有参数的日志。
+ */
+std::string AssembleWithTimestamp(LogAssembler& log_assembler,
+                                  uint64_t timestamp) {
+    static constexpr char format[] = "no arguments";
+    static StaticLogInfo static_info("log_info_test.cc", 1, LogLevel::INFO,
+                                     sizeof(format), 0, 0, format, nullptr,
+                                     nullptr, nullptr, nullptr);
+
+    DynamicLogInfo dynamic_info{};
+    dynamic_info.info_size_ = sizeof(DynamicLogInfo);
+    dynamic_info.timestamp_ = timestamp;
+
+    char buffer[128];
+    log_assembler.setBuffer(buffer, sizeof(buffer));
+    log_assembler.loadLogInfo(&static_info, &dynamic_info, 0);
+    while (log_assembler.hasRemainingData())
+        log_assembler.write();
+    return std::string(buffer, log_assembler.getWritedBytes());
+}
+
+/**
+ * @brief 使用 localtime 和 strftime 生成期望的时间戳。
+ */
+std::string ExpectedTimestamp(int64_t ns, const char* subsecond_fmt,
+                              int64_t subsecond) {
+    char expected[64];
+    time_t seconds = ns / 1000000000;
+    size_t len = strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S",
+                          localtime(&seconds));
+    snprintf(expected + len, sizeof(expected) - len, subsecond_fmt,
+             static_cast<long>(subsecond));
+    return expected;
+}
+
+}  // namespace
+
+TEST_CASE("Timestamps of consecutive logs", "[LogAssembler]") {
+    LogAssembler log_assembler;
+    olog::utils::TscCalibration calibration;
+    calibration.ns_base_ = 1700000000000000000;
+    log_assembler.setTscCalibration(calibration);
+
+    // 同一秒内、跨秒以及回到之前某一秒的日志。
+    const int64_t ns_timestamps[] = {
+        1700000000123456789, 1700000000999999999, 1700000001000000000,
+        1700000061007000001, 1700000000456000000, 1700003600000000000};
+    for (int64_t ns : ns_timestamps) {
+        std::string expected =
+            ExpectedTimestamp(ns, ".%03ld ", ns % 1000000000 / 1000000);
+        REQUIRE(AssembleWithTimestamp(log_assembler, ns - calibration.ns_base_)
+                    .compare(0, expected.size(), expected) == 0);
+    }
+}
+
+TEST_CASE("Timestamp precisions and calibration", "[LogAssembler]") {
+    LogAssembler log_assembler;
+
+    // 每个计数等于 2.5 纳秒。
+    olog::utils::TscCalibration calibration;
+    calibration.tsc_base_ = 1000;
+    calibration.ns_base_ = 1700000000000000000;
+    calibration.ns_per_tick_ = 2.5;
+    log_assembler.setTscCalibration(calibration);
+
+    const uint64_t tsc = 1000 + 49382716;
+    const int64_t ns = 1700000000123456790;
+    REQUIRE(calibration.toNs(tsc) == ns);
+
+    log_assembler.setTimestampPrecision(TimestampPrecision::MICROSECOND);
+    std::string expected = ExpectedTimestamp(ns, ".%06ld ", 123456);
+    REQUIRE(AssembleWithTimestamp(log_assembler, tsc)
+                .compare(0, expected.size(), expected) == 0);
+
+    log_assembler.setTimestampPrecision(TimestampPrecision::NANOSECOND);
+    expected = ExpectedTimestamp(ns, ".%09ld ", 123456790);
+    REQUIRE(AssembleWithTimestamp(log_assembler, tsc)
+                .compare(0, expected.size(), expected) == 0);
+
+    // 早于校准基准点的计数。
+    REQUIRE(calibration.toNs(600) == 1700000000000000000 - 1000);
+}
+
+TEST_CASE("Prefixes of text logs", "[MakeStaticPrefix][MakeProducerPrefix]") {
+    constexpr char format[] = "no arguments";
+    StaticLogInfo static_info("log_info_test.cc", 42, LogLevel::WARNING,
+                              sizeof(format), 0, 0, format, nullptr, nullptr,
+                              nullptr, nullptr);
+    REQUIRE(MakeStaticPrefix(static_info) == "log_info_test.cc:42 [WARNING]");
+    REQUIRE(MakeProducerPrefix(7) == "[7]: ");
+}
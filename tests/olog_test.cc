@@ -1,7 +1,16 @@
 #include "olog.h"
 
+#include <atomic>
 #include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 TEST_CASE("OLOG won't change the variable", "[OLOG]") {
     OLOG(LogLevel::INFO, "Hello %*lf World!", 10, 3.1415);
@@ -22,4 +31,407 @@ TEST_CASE("OLOG in loop", "[OLOG]") {
     for (int i = 0; i < std::size("Everything is over."); ++i) {
         OLOG(LogLevel::INFO, "%.*s %d", i, str, i);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("OLOG with ordered output", "[OLOG]") {
+    Logger::SetOrderedOutput(true);
+    REQUIRE(Logger::IsOrderedOutput());
+
+    std::thread producer([] {
+        for (int i = 0; i < 100; ++i)
+            OLOG(LogLevel::INFO, "producer: %d", i);
+    });
+    for (int i = 0; i < 100; ++i)
+        OLOG(LogLevel::INFO, "main: %d", i);
+    producer.join();
+
+    Logger::SetOrderedOutput(false);
+}
+
+TEST_CASE("OLOG drops records that don't fit", "[OLOG]") {
+    // 比生产者缓冲区还大的日志永远无法写入，阻塞时会使生产者一直等待。
+    std::string huge(olog::config::STORAGE_BUFFER_SIZE, 'x');
+
+    Logger::SetOverflowPolicy(OverflowPolicy::DROP);
+    REQUIRE(Logger::GetOverflowPolicy() == OverflowPolicy::DROP);
+    OLOG(LogLevel::INFO, "dropped: %s", huge.c_str());
+
+    Logger::SetOverflowPolicy(OverflowPolicy::DROP_AND_COUNT);
+    for (int i = 0; i < 3; ++i)
+        OLOG(LogLevel::INFO, "dropped and counted: %s", huge.c_str());
+    OLOG(LogLevel::INFO, "after dropping: %d", 3);
+
+    Logger::SetOverflowPolicy(OverflowPolicy::BLOCK);
+}
+
+TEST_CASE("OLOG wakes up the idle consumer", "[OLOG]") {
+    Logger::SetMaxFlushLatency(50 * 1000 * 1000);
+    REQUIRE(Logger::GetMaxFlushLatency() == 50 * 1000 * 1000);
+
+    // 等待日志线程进入休眠。
+    for (int i = 0; i < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        OLOG(LogLevel::INFO, "after idle: %d", i);
+    }
+
+    Logger::SetMaxFlushLatency(olog::config::DEFAULT_MAX_FLUSH_LATENCY_NS);
+}
+
+TEST_CASE("OLOG with different durability policies", "[OLOG]") {
+    Logger::SetDurabilityPolicy(DurabilityPolicy::ON_ERROR);
+    REQUIRE(Logger::GetDurabilityPolicy() == DurabilityPolicy::ON_ERROR);
+    OLOG(LogLevel::ERROR, "synced error: %d", 1);
+    OLOG(LogLevel::INFO, "after synced error: %d", 1);
+
+    Logger::SetDurabilityPolicy(DurabilityPolicy::PERIODIC);
+    for (int i = 0; i < 3; ++i)
+        OLOG(LogLevel::INFO, "periodically synced: %d", i);
+
+    Logger::SetDurabilityPolicy(DurabilityPolicy::EVERY_WRITE);
+}
+
+TEST_CASE("OLOG rotates the log file by size", "[OLOG]") {
+    char dir_template[] = "/tmp/olog_rotation_XXXXXX";
+    REQUIRE(mkdtemp(dir_template) != nullptr);
+    std::filesystem::path dir(dir_template);
+
+    Logger::SetRotationSize(1);
+    REQUIRE(Logger::GetRotationSize() == 1);
+    Logger::SetLogFile((dir / "rotated.log").c_str());
+
+    // 每次写出后都会提交轮转，新文件打开后在下一次写出时换上。
+    for (int i = 0; i < 5; ++i) {
+        OLOG(LogLevel::INFO, "rotated: %d", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    Logger::SetRotationSize(0);
+    Logger::SetLogFile("/dev/null");
+    OLOG(LogLevel::INFO, "after rotation: %d", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto num_files =
+        std::distance(std::filesystem::directory_iterator(dir),
+                      std::filesystem::directory_iterator());
+    REQUIRE(num_files >= 2);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("OLOG writes compressed frames", "[OLOG]") {
+    char path_template[] = "/tmp/olog_compression_XXXXXX";
+    int fd = mkstemp(path_template);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    Logger::SetLogFile(path_template);
+    Logger::SetCompressor(
+        std::make_unique<olog::compression::NoopCompressor>());
+    REQUIRE(Logger::IsCompressionEnabled());
+    OLOG(LogLevel::INFO, "compressed: %d", 42);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    Logger::SetCompressor(nullptr);
+    REQUIRE_FALSE(Logger::IsCompressionEnabled());
+    Logger::SetLogFile("/dev/null");
+    OLOG(LogLevel::INFO, "after compression: %d", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    FILE* input = fopen(path_template, "rb");
+    REQUIRE(input != nullptr);
+    olog::compression::FrameReader reader(input);
+    std::string content;
+    while (reader.next())
+        content.append(reader.getData(), reader.getSize());
+    REQUIRE(reader.isComplete());
+    REQUIRE(content.find("compressed: 42") != std::string::npos);
+    fclose(input);
+    remove(path_template);
+}
+
+TEST_CASE("OLOG writes to sinks by level", "[OLOG]") {
+    char dir_template[] = "/tmp/olog_sinks_XXXXXX";
+    REQUIRE(mkdtemp(dir_template) != nullptr);
+    std::filesystem::path dir(dir_template);
+
+    int warning_sink =
+        Logger::AddSink((dir / "warning.log").c_str(), LogLevel::WARNING);
+    int error_sink = Logger::AddSink((dir / "error.bin").c_str(),
+                                     LogLevel::ERROR, OutputFormat::BINARY);
+    OLOG(LogLevel::INFO, "sink info: %d", 1);
+    OLOG(LogLevel::WARNING, "sink warning: %d", 2);
+    OLOG(LogLevel::ERROR, "sink error: %d", 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Logger::RemoveSink(warning_sink);
+    Logger::RemoveSink(error_sink);
+    OLOG(LogLevel::ERROR, "after sinks: %d", 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    FILE* input = fopen((dir / "warning.log").c_str(), "rb");
+    REQUIRE(input != nullptr);
+    std::string content;
+    char buffer[4096];
+    size_t nread = 0;
+    while ((nread = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        content.append(buffer, nread);
+    fclose(input);
+    REQUIRE(content.find("sink info: 1") == std::string::npos);
+    REQUIRE(content.find("sink warning: 2") != std::string::npos);
+    REQUIRE(content.find("sink error: 3") != std::string::npos);
+    REQUIRE(content.find("after sinks: 4") == std::string::npos);
+
+    input = fopen((dir / "error.bin").c_str(), "rb");
+    REQUIRE(input != nullptr);
+    olog::binary_log::BinaryLogReader reader(input);
+    REQUIRE(reader.next());
+    REQUIRE(reader.getStaticInfo()->log_level_ == LogLevel::ERROR);
+    REQUIRE_FALSE(reader.next());
+    fclose(input);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("OLOG keeps writing the log file while a sink is stalled",
+          "[OLOG]") {
+    char path_template[] = "/tmp/olog_stalled_sink_XXXXXX";
+    int fd = mkstemp(path_template);
+    REQUIRE(fd >= 0);
+    close(fd);
+    Logger::SetLogFile(path_template);
+
+    // 没有人读取的管道，写满之后对它的写入一直无法完成。
+    int pipe_fds[2];
+    REQUIRE(pipe(pipe_fds) == 0);
+    int sink = Logger::AddSink(pipe_fds[1], LogLevel::INFO);
+    std::string padding(256, 'x');
+    for (int i = 0; i < 1024; ++i)
+        OLOG(LogLevel::INFO, "stalled sink: %d %s", i, padding.c_str());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // 日志线程空闲时不等待管道，之后的日志仍然写入日志文件。
+    for (int i = 0; i < 3; ++i) {
+        OLOG(LogLevel::INFO, "after stalled sink: %d", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    FILE* input = fopen(path_template, "rb");
+    REQUIRE(input != nullptr);
+    std::string content;
+    char buffer[4096];
+    size_t nread = 0;
+    while ((nread = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        content.append(buffer, nread);
+    fclose(input);
+
+    // 读空管道，RemoveSink 才能等到写入完成。
+    std::thread reader([fd = pipe_fds[0]] {
+        char discard[4096];
+        while (read(fd, discard, sizeof(discard)) > 0) {
+        }
+    });
+    Logger::RemoveSink(sink);
+    OLOG(LogLevel::INFO, "after removing stalled sink: %d", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    close(pipe_fds[1]);
+    reader.join();
+    close(pipe_fds[0]);
+    Logger::SetLogFile("/dev/null");
+    remove(path_template);
+
+    REQUIRE(content.find("after stalled sink: 2") != std::string::npos);
+}
+
+TEST_CASE("OLOG skips arguments of filtered logs", "[OLOG]") {
+    Logger::SetLogLevel(LogLevel::WARNING);
+    REQUIRE(Logger::GetLogLevel() == LogLevel::WARNING);
+    int a = 0;
+    OLOG(LogLevel::INFO, "val: %d", ++a);
+    REQUIRE(a == 0);
+    OLOG(LogLevel::WARNING, "val: %d", ++a);
+    REQUIRE(a == 1);
+    Logger::SetLogLevel(LogLevel::INFO);
+}
+
+TEST_CASE("OLOG enables and disables call sites", "[OLOG]") {
+    int a = 0;
+    auto log_debug = [&a] { OLOG(LogLevel::DEBUG, "site debug: %d", ++a); };
+    auto log_info = [&a] { OLOG(LogLevel::INFO, "site info: %d", ++a); };
+
+    log_debug();
+    log_info();
+    REQUIRE(a == 1);
+
+#ifdef OLOG_LINK_TIME_REGISTRATION
+    // 链接时登记的调用点包括下面尚未执行的那一个。
+    const size_t num_info_sites = 2;
+#else
+    const size_t num_info_sites = 1;
+#endif
+    REQUIRE(Logger::EnableLogSites(nullptr, 0, "site debug") == 1);
+    REQUIRE(Logger::DisableLogSites("*olog_test.cc", 0, "site info") ==
+            num_info_sites);
+    log_debug();
+    REQUIRE(a == 2);
+    log_info();
+    REQUIRE(a == 2);
+
+    // 规则也作用于之后才第一次执行的调用点。
+    OLOG(LogLevel::INFO, "site info: %d", ++a);
+    REQUIRE(a == 2);
+    REQUIRE(Logger::DisableLogSites("*no_such_file.cc") == 0);
+
+    Logger::ResetLogSites();
+    log_debug();
+    log_info();
+    REQUIRE(a == 3);
+}
+
+TEST_CASE("OLOG variants limit how often a site logs", "[OLOG]") {
+    char dir_template[] = "/tmp/olog_limited_XXXXXX";
+    REQUIRE(mkdtemp(dir_template) != nullptr);
+    std::filesystem::path dir(dir_template);
+    int sink = Logger::AddSink((dir / "limited.log").c_str(), LogLevel::INFO);
+
+    int num_evaluated = 0;
+    for (int i = 0; i < 10; ++i) {
+        OLOG_EVERY_N(LogLevel::INFO, 4, "every n: %d", (++num_evaluated, i));
+        OLOG_FIRST_N(LogLevel::INFO, 2, "first n: %d", (++num_evaluated, i));
+        OLOG_EVERY_MS(LogLevel::INFO, 60 * 1000, "every ms: %d",
+                      (++num_evaluated, i));
+        OLOG_RATE_LIMITED(LogLevel::INFO, 1, 2, "rate limited: %d",
+                          (++num_evaluated, i));
+        OLOG_EVERY_N(LogLevel::DEBUG, 1, "filtered: %d", (++num_evaluated, i));
+    }
+    REQUIRE(num_evaluated == 3 + 2 + 1 + 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Logger::RemoveSink(sink);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    FILE* input = fopen((dir / "limited.log").c_str(), "rb");
+    REQUIRE(input != nullptr);
+    std::string content;
+    char buffer[4096];
+    size_t nread = 0;
+    while ((nread = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        content.append(buffer, nread);
+    fclose(input);
+    REQUIRE(content.find("every n: 0") != std::string::npos);
+    REQUIRE(content.find("every n: 4 (suppressed 3)") != std::string::npos);
+    REQUIRE(content.find("every n: 8 (suppressed 3)") != std::string::npos);
+    REQUIRE(content.find("first n: 1") != std::string::npos);
+    REQUIRE(content.find("first n: 2") == std::string::npos);
+    REQUIRE(content.find("every ms: 0") != std::string::npos);
+    REQUIRE(content.find("every ms: 1") == std::string::npos);
+    REQUIRE(content.find("rate limited: 1") != std::string::npos);
+    REQUIRE(content.find("rate limited: 2") == std::string::npos);
+    REQUIRE(content.find("filtered") == std::string::npos);
+    std::filesystem::remove_all(dir);
+}
+
+#ifdef OLOG_LINK_TIME_REGISTRATION
+TEST_CASE("OLOG registers call sites before they run", "[OLOG]") {
+    char dir_template[] = "/tmp/olog_registered_XXXXXX";
+    REQUIRE(mkdtemp(dir_template) != nullptr);
+    std::filesystem::path dir(dir_template);
+    int sink = Logger::AddSink((dir / "registered.bin").c_str(),
+                               LogLevel::ERROR, OutputFormat::BINARY);
+
+    // 该调用点从未执行，但它的格式字符串仍然出现在格式字典中。
+    if (dir.empty())
+        OLOG(LogLevel::INFO, "never executed: %d", 1);
+    OLOG(LogLevel::ERROR, "registered: %d", 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Logger::RemoveSink(sink);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    FILE* input = fopen((dir / "registered.bin").c_str(), "rb");
+    REQUIRE(input != nullptr);
+    std::string content;
+    char buffer[4096];
+    size_t nread = 0;
+    while ((nread = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        content.append(buffer, nread);
+    fclose(input);
+    REQUIRE(content.find("never executed: %d") != std::string::npos);
+    REQUIRE(content.find("registered: %d") != std::string::npos);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Call sites have ids before their first call", "[OLOG]") {
+    // 与 OLOG 相同地向 olog_static_info 段写入条目，但从不调用 Log，
+    // id 和调用点状态只能来自 Logger 构造时对该段的遍历。
+    using namespace olog::log_info;
+    static constexpr char format[] = "registered at link time";
+    static constexpr std::array<ParamType, 0> param_types{};
+    static constexpr std::array<size_t, 0> param_sizes{};
+    static constexpr StaticLogInfo static_info(
+        __FILE__, __LINE__, LogLevel::INFO, sizeof(format), 0, 0, format,
+        nullptr, nullptr, param_types.data(), param_sizes.data());
+    static std::atomic<int> log_id{UNREGISTERED_LOG_ID};
+    static std::atomic<olog::logger::LogSiteState> site_state{
+        olog::logger::LogSiteState::UNREGISTERED};
+    OLOG_REGISTER_STATIC_INFO(static_info, log_id, site_state);
+
+    Logger::GetInstance();
+    REQUIRE(log_id.load() >= 0);
+    REQUIRE(site_state.load() == olog::logger::LogSiteState::BY_LEVEL);
+}
+#endif
+
+TEST_CASE("Racing registrations add the static info once", "[OLOG]") {
+    using namespace olog::log_info;
+    static constexpr char format[] = "raced registration";
+    static constexpr std::array<ParamType, 0> param_types{};
+    static constexpr std::array<size_t, 0> param_sizes{};
+    static constexpr StaticLogInfo static_info(
+        __FILE__, __LINE__, LogLevel::ERROR, sizeof(format), 0, 0, format,
+        nullptr, nullptr, param_types.data(), param_sizes.data());
+
+    char dir_template[] = "/tmp/olog_raced_XXXXXX";
+    REQUIRE(mkdtemp(dir_template) != nullptr);
+    std::filesystem::path dir(dir_template);
+    int sink = Logger::AddSink((dir / "raced.bin").c_str(), LogLevel::ERROR,
+                               OutputFormat::BINARY);
+
+    // 多个线程同时第一次注册同一调用点，都得到同一个 id。
+    std::atomic<int> log_id{UNREGISTERED_LOG_ID};
+    std::atomic<bool> start{false};
+    std::vector<int> ids(8, UNREGISTERED_LOG_ID);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        threads.emplace_back([&, i] {
+            while (!start.load())
+                std::this_thread::yield();
+            Logger::RegisterLogInfo(static_info, log_id);
+            ids[i] = log_id.load();
+        });
+    }
+    start.store(true);
+    for (std::thread& thread : threads)
+        thread.join();
+    for (int id : ids) {
+        REQUIRE(id >= 0);
+        REQUIRE(id == ids[0]);
+    }
+
+    // 格式字典只包含一个该静态信息。
+    OLOG(LogLevel::ERROR, "after raced registration: %d", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Logger::RemoveSink(sink);
+    OLOG(LogLevel::ERROR, "after removing raced sink: %d", 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    FILE* input = fopen((dir / "raced.bin").c_str(), "rb");
+    REQUIRE(input != nullptr);
+    std::string content;
+    char buffer[4096];
+    size_t nread = 0;
+    while ((nread = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        content.append(buffer, nread);
+    fclose(input);
+    std::filesystem::remove_all(dir);
+
+    // 同时匹配格式串结尾的 '\0'，不计入 "after raced registration"。
+    std::string needle(format, sizeof(format));
+    size_t count = 0;
+    for (size_t pos = content.find(needle); pos != std::string::npos;
+         pos = content.find(needle, pos + 1))
+        ++count;
+    REQUIRE(count == 1);
+}
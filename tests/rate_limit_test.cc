@@ -0,0 +1,83 @@
+#include "rate_limit.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+using namespace olog::rate_limit;
+
+TEST_CASE("EveryN logs every n-th call", "[EveryN]") {
+    EveryN limiter(3);
+    std::vector<uint64_t> suppressed;
+    for (int i = 0; i < 10; ++i) {
+        uint64_t num_suppressed = 0;
+        if (limiter.shouldLog(num_suppressed))
+            suppressed.push_back(num_suppressed);
+    }
+    REQUIRE(suppressed == std::vector<uint64_t>{0, 2, 2, 2});
+}
+
+TEST_CASE("FirstN logs only the first n calls", "[FirstN]") {
+    FirstN limiter(2);
+    uint64_t num_suppressed = 0;
+    REQUIRE(limiter.shouldLog(num_suppressed));
+    REQUIRE(limiter.shouldLog(num_suppressed));
+    for (int i = 0; i < 10; ++i)
+        REQUIRE_FALSE(limiter.shouldLog(num_suppressed));
+    REQUIRE(num_suppressed == 0);
+}
+
+TEST_CASE("EveryInterval reports suppressed calls", "[EveryInterval]") {
+    EveryInterval limiter(1000);
+    uint64_t num_suppressed = 0;
+    REQUIRE(limiter.shouldLog(num_suppressed, 5000));
+    REQUIRE(num_suppressed == 0);
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, 5001));
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, 5999));
+    REQUIRE(limiter.shouldLog(num_suppressed, 6000));
+    REQUIRE(num_suppressed == 2);
+    REQUIRE(limiter.shouldLog(num_suppressed, 9000));
+    REQUIRE(num_suppressed == 0);
+}
+
+TEST_CASE("TokenBucket allows bursts up to its capacity", "[TokenBucket]") {
+    // 每 100 毫秒补充一个令牌，桶中最多 3 个。
+    TokenBucket limiter(10, 3);
+    const int64_t interval_ns = 100 * 1000 * 1000;
+    int64_t now_ns = 1000 * 1000 * 1000;
+    uint64_t num_suppressed = 0;
+
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(limiter.shouldLog(num_suppressed, now_ns));
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, now_ns));
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, now_ns + interval_ns / 2));
+
+    now_ns += interval_ns;
+    REQUIRE(limiter.shouldLog(num_suppressed, now_ns));
+    REQUIRE(num_suppressed == 2);
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, now_ns));
+
+    // 长时间空闲后桶被重新填满，但不会超过容量。
+    now_ns += 100 * interval_ns;
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(limiter.shouldLog(num_suppressed, now_ns));
+    REQUIRE_FALSE(limiter.shouldLog(num_suppressed, now_ns));
+}
+
+TEST_CASE("Suppressed counts from all threads are reported",
+          "[SuppressedCounter]") {
+    constexpr int NUM_THREADS = 16;
+    constexpr int NUM_CALLS = 10000;
+    SuppressedCounter counter;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back([&counter] {
+            for (int j = 0; j < NUM_CALLS; ++j)
+                counter.add();
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    REQUIRE(counter.take() == NUM_THREADS * NUM_CALLS);
+    REQUIRE(counter.take() == 0);
+}
@@ -0,0 +1,69 @@
+#include "registry.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+using namespace olog::log_info;
+using namespace olog::registry;
+
+namespace {
+
+StaticLogInfo MakeStaticInfo(uint32_t line_number) {
+    return StaticLogInfo("registry_test.cc", line_number, LogLevel::INFO, 1, 0,
+                         0, "", nullptr, nullptr, nullptr, nullptr);
+}
+
+}  // namespace
+
+TEST_CASE("Ids are assigned in order", "[StaticInfoRegistry]") {
+    StaticInfoRegistry registry;
+    REQUIRE(registry.size() == 0);
+
+    // 跨越前几个段的边界。
+    constexpr uint32_t NUM_INFOS =
+        olog::config::REGISTRY_FIRST_SEGMENT_SIZE * 7;
+    for (uint32_t i = 0; i < NUM_INFOS; ++i)
+        REQUIRE(registry.add(MakeStaticInfo(i)) == i);
+    REQUIRE(registry.size() == NUM_INFOS);
+
+    const StaticLogInfo* first = &registry.get(0);
+    for (uint32_t i = 0; i < NUM_INFOS; ++i) {
+        REQUIRE(registry.isPublished(i));
+        REQUIRE(registry.get(i).line_number_ == i);
+    }
+    // 之后的注册不会移动已注册的静态信息。
+    registry.add(MakeStaticInfo(NUM_INFOS));
+    REQUIRE(&registry.get(0) == first);
+}
+
+TEST_CASE("Threads register concurrently", "[StaticInfoRegistry]") {
+    constexpr uint32_t NUM_THREADS = 8;
+    constexpr uint32_t NUM_INFOS_PER_THREAD = 5000;
+    StaticInfoRegistry registry;
+
+    std::vector<std::vector<size_t>> ids(NUM_THREADS);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([&registry, &ids, t] {
+            for (uint32_t i = 0; i < NUM_INFOS_PER_THREAD; ++i) {
+                ids[t].push_back(
+                    registry.add(MakeStaticInfo(t * NUM_INFOS_PER_THREAD + i)));
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    REQUIRE(registry.size() == NUM_THREADS * NUM_INFOS_PER_THREAD);
+    std::vector<bool> seen(registry.size(), false);
+    for (uint32_t t = 0; t < NUM_THREADS; ++t) {
+        for (uint32_t i = 0; i < NUM_INFOS_PER_THREAD; ++i) {
+            size_t id = ids[t][i];
+            REQUIRE_FALSE(seen[id]);
+            seen[id] = true;
+            REQUIRE(registry.get(id).line_number_ ==
+                    t * NUM_INFOS_PER_THREAD + i);
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
 #include <ctime>
+#include <thread>
 
 #include "utils.h"
 
@@ -16,4 +18,50 @@ TEST_CASE("Get current time", "[GetMsSystemClockInterval]") {
     strftime(cur_time_str, sizeof(cur_time_str), "%Y-%m-%d %H:%M:%S", localtime(&cur_time));
 
     REQUIRE(strcmp(start_time_str, cur_time_str) == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Timestamp counter calibration", "[TscClock]") {
+    TscClock clock;
+    REQUIRE(clock.getCalibration().ns_per_tick_ > 0);
+
+    // 转换得到的时间与系统时钟的误差应当很小。
+    int64_t diff = clock.getCalibration().toNs(ReadTsc()) -
+                   GetNsSystemClockInterval();
+    REQUIRE(std::abs(diff) < 10 * 1000 * 1000);
+
+    REQUIRE_FALSE(clock.recalibrateIfNeeded(1000LL * 1000 * 1000 * 3600));
+    double ns_per_tick = clock.getCalibration().ns_per_tick_;
+    REQUIRE(clock.recalibrateIfNeeded(0));
+    diff = clock.getCalibration().toNs(ReadTsc()) - GetNsSystemClockInterval();
+    REQUIRE(std::abs(diff) < 10 * 1000 * 1000);
+
+    // 频率由单调时钟测量，重新校准后只有很小的变化。
+    double ratio = clock.getCalibration().ns_per_tick_ / ns_per_tick;
+    REQUIRE(ratio > 0.9);
+    REQUIRE(ratio < 1.1);
+}
+
+TEST_CASE("Futex wait and wake", "[FutexWait][FutexWake]") {
+    std::atomic<uint32_t> word(0);
+
+    // 值不等于期望值时立即返回。
+    int64_t start = GetNsSystemClockInterval();
+    FutexWait(word, 1, 1000LL * 1000 * 1000);
+    REQUIRE(GetNsSystemClockInterval() - start < 500 * 1000 * 1000);
+
+    // 没有被唤醒时超时返回。
+    start = GetNsSystemClockInterval();
+    FutexWait(word, 0, 10 * 1000 * 1000);
+    REQUIRE(GetNsSystemClockInterval() - start >= 5 * 1000 * 1000);
+
+    std::thread waker([&word] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        word.store(1);
+        FutexWake(word);
+    });
+    start = GetNsSystemClockInterval();
+    while (word.load() == 0)
+        FutexWait(word, 0, 10LL * 1000 * 1000 * 1000);
+    REQUIRE(GetNsSystemClockInterval() - start < 5LL * 1000 * 1000 * 1000);
+    waker.join();
+}
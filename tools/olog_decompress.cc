@@ -0,0 +1,198 @@
+/**
+ * olog_decompress: 将 OutputFormat::BINARY 模式下写出的日志文件恢复为文本。
+ * 设置了压缩器的日志文件先逐帧解压，其中的文本日志解压后原样输出。
+ *
+ * 用法：olog_decompress [-p ms|us|ns] <log file> [output file]
+ * -p 指定时间戳的精度，默认为毫秒。
+ * 未指定输出文件时输出到标准输出。
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "binary_log.h"
+#include "compression.h"
+#include "log_info.h"
+
+namespace {
+
+// 恢复文本时使用的缓冲区大小。
+const size_t OUTPUT_BUFFER_SIZE = 1024 * 1024;
+
+/**
+ * @brief
+ * 将二进制日志逐条恢复为文本并写入 output。
+ *
+ * @throw std::runtime_error 输入不是 OLog 的二进制日志或内容已损坏。
+ */
+void Decompress(FILE* input, FILE* output,
+                olog::log_info::TimestampPrecision precision) {
+    olog::binary_log::BinaryLogReader reader(input);
+    olog::log_info::LogAssembler log_assembler;
+    log_assembler.setTimestampPrecision(precision);
+    std::unique_ptr<char[]> buffer =
+        std::make_unique<char[]>(OUTPUT_BUFFER_SIZE);
+    log_assembler.setBuffer(buffer.get(), OUTPUT_BUFFER_SIZE);
+
+    while (reader.next()) {
+        log_assembler.setTscCalibration(reader.getCalibration());
+        log_assembler.loadLogInfo(reader.getStaticInfo(),
+                                  reader.getDynamicInfo(),
+                                  reader.getProducerId());
+        while (log_assembler.hasRemainingData()) {
+            log_assembler.write();
+            if (log_assembler.isBufferFull()) {
+                fwrite(buffer.get(), 1, log_assembler.getWritedBytes(), output);
+                log_assembler.setBuffer(buffer.get(), OUTPUT_BUFFER_SIZE);
+            }
+        }
+    }
+    fwrite(buffer.get(), 1, log_assembler.getWritedBytes(), output);
+}
+
+/**
+ * @brief
+ * 检查文件是否以二进制日志的文件头开头，之后从文件开头继续读取。
+ */
+bool IsBinaryLog(FILE* input) {
+    olog::binary_log::EntryHeader entry_header;
+    olog::binary_log::FileHeader file_header;
+    bool ret = fread(&entry_header, sizeof(entry_header), 1, input) == 1 &&
+               fread(&file_header, sizeof(file_header), 1, input) == 1 &&
+               entry_header.entry_type_ ==
+                   olog::binary_log::EntryType::FILE_HEADER &&
+               memcmp(file_header.magic_, olog::binary_log::FILE_MAGIC,
+                      sizeof(olog::binary_log::FILE_MAGIC)) == 0;
+    rewind(input);
+    return ret;
+}
+
+/**
+ * @brief
+ * 检查文件是否由压缩后的帧组成，之后从文件开头继续读取。
+ */
+bool IsCompressedLog(FILE* input) {
+    char magic[sizeof(olog::compression::FRAME_MAGIC)];
+    bool ret = fread(magic, sizeof(magic), 1, input) == 1 &&
+               memcmp(magic, olog::compression::FRAME_MAGIC,
+                      sizeof(magic)) == 0;
+    rewind(input);
+    return ret;
+}
+
+/**
+ * @brief
+ * 将压缩后的日志文件逐帧解压到临时文件中。
+ * 遇到不完整的帧（例如进程崩溃时写入被中断）时只给出警告，保留之前的内容。
+ *
+ * @return 已经回到开头的临时文件，由调用者负责关闭。
+ * @throw std::runtime_error 无法创建临时文件。
+ */
+FILE* DecompressFrames(FILE* input, const char* input_name) {
+    FILE* decompressed = tmpfile();
+    if (decompressed == nullptr)
+        throw std::runtime_error(std::string("Can't create temporary file: ") +
+                                 strerror(errno));
+
+    olog::compression::FrameReader reader(input);
+    while (reader.next())
+        fwrite(reader.getData(), 1, reader.getSize(), decompressed);
+    if (!reader.isComplete())
+        fprintf(stderr, "%s: stopped at an incomplete frame\n", input_name);
+
+    rewind(decompressed);
+    return decompressed;
+}
+
+/**
+ * @brief
+ * 将 input 中剩余的内容原样写入 output。
+ */
+void Copy(FILE* input, FILE* output) {
+    std::unique_ptr<char[]> buffer =
+        std::make_unique<char[]>(OUTPUT_BUFFER_SIZE);
+    size_t nread = 0;
+    while ((nread = fread(buffer.get(), 1, OUTPUT_BUFFER_SIZE, input)) > 0)
+        fwrite(buffer.get(), 1, nread, output);
+}
+
+void PrintUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [-p ms|us|ns] <log file> [output file]\n",
+            program);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    olog::log_info::TimestampPrecision precision =
+        olog::log_info::TimestampPrecision::MILLISECOND;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        if (opt == 'p' && strcmp(optarg, "ms") == 0) {
+            precision = olog::log_info::TimestampPrecision::MILLISECOND;
+        } else if (opt == 'p' && strcmp(optarg, "us") == 0) {
+            precision = olog::log_info::TimestampPrecision::MICROSECOND;
+        } else if (opt == 'p' && strcmp(optarg, "ns") == 0) {
+            precision = olog::log_info::TimestampPrecision::NANOSECOND;
+        } else {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int num_files = argc - optind;
+    if (num_files < 1 || num_files > 2) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char* input_name = argv[optind];
+    const char* output_name = num_files == 2 ? argv[optind + 1] : nullptr;
+
+    FILE* input = fopen(input_name, "rb");
+    if (input == nullptr) {
+        fprintf(stderr, "Can't open file: %s: %s\n", input_name,
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    FILE* output = stdout;
+    if (output_name != nullptr) {
+        output = fopen(output_name, "wb");
+        if (output == nullptr) {
+            fprintf(stderr, "Can't open file: %s: %s\n", output_name,
+                    strerror(errno));
+            fclose(input);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int exit_code = EXIT_SUCCESS;
+    FILE* decompressed = nullptr;
+    try {
+        if (IsCompressedLog(input))
+            decompressed = DecompressFrames(input, input_name);
+
+        // 压缩后的文本日志解压后就是原来的文本。
+        if (decompressed != nullptr && !IsBinaryLog(decompressed))
+            Copy(decompressed, output);
+        else
+            Decompress(decompressed != nullptr ? decompressed : input, output,
+                       precision);
+    } catch (const std::runtime_error& e) {
+        fprintf(stderr, "%s: %s\n", input_name, e.what());
+        exit_code = EXIT_FAILURE;
+    }
+
+    if (decompressed != nullptr)
+        fclose(decompressed);
+    fclose(input);
+    if (output != stdout)
+        fclose(output);
+    return exit_code;
+}